@@ -74,3 +74,18 @@ if (NOT polo_FOUND)
       googletest
   )
 endif()
+
+if (NOT benchmark_FOUND)
+  ExternalProject_Add(
+    benchmark
+    GIT_REPOSITORY
+      https://github.com/google/benchmark
+    GIT_TAG
+      v1.4.1
+    CMAKE_ARGS
+      -D CMAKE_INSTALL_PREFIX=${CMAKE_INSTALL_PREFIX}
+      -D CMAKE_BUILD_TYPE=Release
+      -D BENCHMARK_ENABLE_TESTING=OFF
+      -D BENCHMARK_ENABLE_GTEST_TESTS=OFF
+  )
+endif()
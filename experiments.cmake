@@ -1,5 +1,8 @@
 if (NOT polo_FOUND)
-  set(experimentsDepends polo)
+  list(APPEND experimentsDepends polo)
+endif()
+if (NOT benchmark_FOUND)
+  list(APPEND experimentsDepends benchmark)
 endif()
 
 ExternalProject_Add(
@@ -11,6 +14,7 @@ ExternalProject_Add(
   CMAKE_ARGS
     -D CMAKE_BUILD_TYPE=Release
     -D CMAKE_PREFIX_PATH=${CMAKE_PREFIX_PATH}
+    -D PS_NWORKERS=${PS_NWORKERS}
   INSTALL_COMMAND
     ""
 )
@@ -0,0 +1,158 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+using namespace std;
+
+#include "benchmark/benchmark.h"
+
+#include "polo/polo.hpp"
+using namespace polo;
+
+#include "batchsampler.hpp"
+#include "csrlogistic.hpp"
+#include "registry.hpp"
+#include "rng.hpp"
+
+using index_t = int32_t;
+using value_t = float;
+
+/* rcv1's first shard, loaded once and shared by all benchmarks and threads */
+struct shard {
+  static const shard &get() {
+    static once_flag flag;
+    static unique_ptr<shard> instance;
+    call_once(flag, []() { instance.reset(new shard); });
+    return *instance;
+  }
+
+  loss::data<value_t, index_t> dataset;
+  mappedcsr<value_t, index_t> mapped;
+  string error;
+
+private:
+  shard() {
+    try {
+      const registry<value_t, index_t> datasets("data/datasets.lst");
+      dataset = datasets.load(0, 1);
+      mapped = datasets.map(0, 1);
+    } catch (const exception &ex) {
+      error = ex.what();
+    }
+  }
+};
+
+template <class Loss>
+void sampledloss(benchmark::State &state, const Loss &loss, const index_t N,
+                 const index_t d) {
+  const index_t M = index_t(state.range(0));
+  static atomic<uint64_t> streams{0};
+  const counterrng gen(0, streams++);
+  vector<value_t> x(d), g(d);
+  vector<index_t> indices(M);
+  for (index_t idx = 0; idx < d; idx++)
+    x[idx] = value_t(gen.normal(idx) * 1e-2);
+
+  uint64_t counter{0};
+  for (auto _ : state) {
+    state.PauseTiming();
+    for (auto &index : indices)
+      index = index_t(gen(counter++) % uint64_t(N));
+    sort(begin(indices), end(indices));
+    state.ResumeTiming();
+    benchmark::DoNotOptimize(loss(&x[0], &g[0], &indices[0], &indices[0] + M));
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * M);
+}
+
+void BM_logistic(benchmark::State &state) {
+  const auto &data = shard::get();
+  if (!data.error.empty()) {
+    state.SkipWithError(data.error.c_str());
+    return;
+  }
+  const loss::logistic<value_t, index_t> loss(data.dataset);
+  sampledloss(state, loss, data.dataset.nsamples(), data.dataset.nfeatures());
+}
+
+void BM_csrlogistic(benchmark::State &state) {
+  const auto &data = shard::get();
+  if (!data.error.empty()) {
+    state.SkipWithError(data.error.c_str());
+    return;
+  }
+  const csrlogistic<value_t, index_t> loss(data.mapped.view());
+  sampledloss(state, loss, data.mapped.view().nrows, data.mapped.view().ncols);
+}
+
+void BM_sampler(benchmark::State &state) {
+  const index_t M = index_t(state.range(0)), N = index_t(state.range(1));
+  utility::sampler::uniform<index_t> sampler;
+  sampler.parameters(0, N - 1);
+  vector<index_t> indices(M);
+  for (auto _ : state) {
+    sampler(begin(indices), end(indices));
+    benchmark::DoNotOptimize(indices.data());
+  }
+  state.SetItemsProcessed(state.iterations() * M);
+}
+
+/* the vectorized generation of batchsampler's batches, without the sort */
+void BM_counterrng(benchmark::State &state) {
+  const index_t M = index_t(state.range(0)), N = index_t(state.range(1));
+  const counterrng gen(0, 1);
+  vector<index_t> indices(M);
+  uint64_t b{0};
+  for (auto _ : state) {
+    gen.below(b++ * uint64_t(M), uint32_t(N), indices.data(), size_t(M));
+    benchmark::DoNotOptimize(indices.data());
+  }
+  state.SetItemsProcessed(state.iterations() * M);
+}
+
+/* generation and sort, whose O(M log M) dominates all but tiny batches */
+void BM_batchsampler(benchmark::State &state) {
+  const index_t M = index_t(state.range(0)), N = index_t(state.range(1));
+  batchsampler<value_t, index_t> sampler(0, 1, N);
+  vector<index_t> indices(M);
+  for (auto _ : state) {
+    sampler(begin(indices), end(indices));
+    benchmark::DoNotOptimize(indices.data());
+  }
+  state.SetItemsProcessed(state.iterations() * M);
+}
+
+BENCHMARK(BM_logistic)
+    ->ArgName("M")
+    ->RangeMultiplier(10)
+    ->Range(10, 10000)
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
+BENCHMARK(BM_csrlogistic)
+    ->ArgName("M")
+    ->RangeMultiplier(10)
+    ->Range(10, 10000)
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
+BENCHMARK(BM_sampler)
+    ->ArgNames({"M", "N"})
+    ->RangeMultiplier(10)
+    ->Ranges({{10, 10000}, {100000, 1000000}})
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
+BENCHMARK(BM_counterrng)
+    ->ArgNames({"M", "N"})
+    ->RangeMultiplier(10)
+    ->Ranges({{10, 10000}, {100000, 1000000}})
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
+BENCHMARK(BM_batchsampler)
+    ->ArgNames({"M", "N"})
+    ->RangeMultiplier(10)
+    ->Ranges({{10, 10000}, {100000, 1000000}})
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
@@ -0,0 +1,74 @@
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+#include "benchmark/benchmark.h"
+
+#include "polo/polo.hpp"
+using namespace polo;
+
+#include "quadratic.hpp"
+
+using index_t = int32_t;
+using value_t = float;
+
+/* Problems are generated once per dimension, or read from the qp cache */
+const quadratic<value_t, index_t> &problem(const index_t d) {
+  static mutex mu;
+  static map<index_t, unique_ptr<quadratic<value_t, index_t>>> problems;
+  lock_guard<mutex> lock(mu);
+  auto &qp = problems[d];
+  if (!qp) {
+    const value_t L{20};
+    const string cachefile =
+        quadratic<value_t, index_t>::cachefile("data", d, L, 0);
+    qp.reset(new quadratic<value_t, index_t>);
+    try {
+      qp->load(cachefile, d, L, 0);
+    } catch (const exception &) {
+      *qp = quadratic<value_t, index_t>(d, L, 0,
+                                        max(thread::hardware_concurrency(), 1u));
+      try {
+        qp->save(cachefile);
+      } catch (const exception &) {
+      }
+    }
+  }
+  return *qp;
+}
+
+void BM_quadratic(benchmark::State &state) {
+  const index_t d = index_t(state.range(0)), m = index_t(state.range(1));
+  const auto &qp = problem(d);
+  vector<vector<value_t>> xs(m, vector<value_t>(d, 1)), gs(m, vector<value_t>(d));
+  vector<const value_t *> x(m);
+  vector<value_t *> g(m);
+  vector<double> f(m);
+  for (index_t v = 0; v < m; v++) {
+    x[v] = xs[v].data();
+    g[v] = gs[v].data();
+  }
+  for (auto _ : state) {
+    qp(m, x.data(), g.data(), f.data());
+    benchmark::DoNotOptimize(f.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * m);
+  state.SetBytesProcessed(state.iterations() * (int64_t(d) + 1) * d / 2 *
+                          int64_t(sizeof(value_t)));
+}
+
+BENCHMARK(BM_quadratic)
+    ->ArgNames({"d", "m"})
+    ->Apply([](benchmark::internal::Benchmark *b) {
+      for (const int d : {1000, 2000, 4000})
+        for (const int m : {1, 2, 3, 4})
+          b->Args({d, m});
+    })
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
@@ -0,0 +1,120 @@
+#include <cstdint>
+#include <vector>
+using namespace std;
+
+#include "benchmark/benchmark.h"
+
+#include "polo/polo.hpp"
+using namespace polo;
+
+#include "rng.hpp"
+
+using index_t = int32_t;
+using value_t = float;
+
+/*
+ * The per-iteration cost of the boosting, smoothing and prox policies is
+ * measured by running K iterations of each configuration on a linear loss,
+ * whose gradient is a copy. The differences to the plain gradient step are
+ * the costs of the policies.
+ */
+struct linearloss {
+  value_t operator()(const value_t *x, value_t *g) const {
+    value_t fval{0};
+    for (size_t idx = 0; idx < c.size(); idx++) {
+      fval += c[idx] * x[idx];
+      g[idx] = c[idx];
+    }
+    return fval;
+  }
+
+  vector<value_t> c;
+};
+
+struct nologger {
+  template <class InputIt1, class InputIt2>
+  void operator()(const index_t, const value_t, InputIt1, InputIt1, InputIt2) {}
+};
+
+template <class Algorithm>
+void iterate(benchmark::State &state, Algorithm &alg) {
+  const index_t d = index_t(state.range(0)), K{100};
+  const counterrng gen(0, 0);
+  linearloss loss{vector<value_t>(d)};
+  vector<value_t> x0(d);
+  for (index_t idx = 0; idx < d; idx++) {
+    loss.c[idx] = value_t(gen.normal(idx));
+    x0[idx] = value_t(gen.normal(d + idx));
+  }
+  nologger logger;
+  encoder::identity<value_t, index_t> enc;
+  for (auto _ : state) {
+    state.PauseTiming();
+    alg.initialize(x0);
+    state.ResumeTiming();
+    alg.solve(loss, logger, terminator::iteration<value_t, index_t>(K), enc);
+  }
+  state.SetItemsProcessed(state.iterations() * K * d);
+}
+
+void BM_gradient(benchmark::State &state) {
+  algorithm::proxgradient<value_t, index_t> alg;
+  alg.step_parameters(1e-3);
+  iterate(state, alg);
+}
+
+void BM_l1norm(benchmark::State &state) {
+  algorithm::proxgradient<value_t, index_t, boosting::none, step::constant,
+                          smoothing::none, prox::l1norm>
+      alg;
+  alg.step_parameters(1e-3);
+  alg.prox_parameters(1e-6);
+  iterate(state, alg);
+}
+
+void BM_rmsprop(benchmark::State &state) {
+  algorithm::proxgradient<value_t, index_t, boosting::momentum, step::constant,
+                          smoothing::rmsprop, prox::l1norm>
+      alg;
+  alg.step_parameters(1e-3);
+  alg.boosting_parameters(0.9, 0.1);
+  alg.smoothing_parameters(0.999, 1E-8);
+  alg.prox_parameters(1e-6);
+  iterate(state, alg);
+}
+
+void BM_amsgrad(benchmark::State &state) {
+  algorithm::proxgradient<value_t, index_t, boosting::momentum, step::constant,
+                          smoothing::amsgrad, prox::l1norm>
+      alg;
+  alg.step_parameters(1e-3);
+  alg.boosting_parameters(0.9, 0.1);
+  alg.smoothing_parameters(0.999, 1E-8);
+  alg.prox_parameters(1e-6);
+  iterate(state, alg);
+}
+
+BENCHMARK(BM_gradient)
+    ->ArgName("d")
+    ->RangeMultiplier(10)
+    ->Range(1000, 1000000)
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
+BENCHMARK(BM_l1norm)
+    ->ArgName("d")
+    ->RangeMultiplier(10)
+    ->Range(1000, 1000000)
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
+BENCHMARK(BM_rmsprop)
+    ->ArgName("d")
+    ->RangeMultiplier(10)
+    ->Range(1000, 1000000)
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
+BENCHMARK(BM_amsgrad)
+    ->ArgName("d")
+    ->RangeMultiplier(10)
+    ->Range(1000, 1000000)
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
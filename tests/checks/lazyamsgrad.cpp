@@ -0,0 +1,143 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <vector>
+using namespace std;
+
+#include "polo/polo.hpp"
+using namespace polo;
+
+#include "csr.hpp"
+#include "lazyamsgrad.hpp"
+
+/*
+ * Compares lazyamsgrad, whose untouched coordinates are caught up in closed
+ * form, with a dense implementation of the same recursion that updates every
+ * coordinate in every iteration.
+ */
+
+using index_t = int32_t;
+using value_t = double;
+
+struct parameters {
+  value_t gamma, mu, beta, delta, lambda;
+};
+
+/* rows touching few of the d columns, so most catch-ups span many steps */
+csrmatrix<value_t, index_t> sparsematrix(const index_t N, const index_t d) {
+  mt19937 generator(1);
+  uniform_int_distribution<index_t> column(0, d - 1), length(1, 3);
+  normal_distribution<value_t> value(0, 1);
+  csrmatrix<value_t, index_t> A;
+  A.nrows = N;
+  A.ncols = d;
+  A.rowptr.push_back(0);
+  for (index_t row = 0; row < N; row++) {
+    vector<index_t> cols(length(generator));
+    for (auto &col : cols)
+      col = column(generator);
+    sort(begin(cols), end(cols));
+    cols.erase(unique(begin(cols), end(cols)), end(cols));
+    for (const auto col : cols) {
+      A.colind.push_back(col);
+      A.values.push_back(value(generator));
+    }
+    A.labels.push_back(row % 2 ? 1 : -1);
+    A.rowptr.push_back(index_t(A.values.size()));
+  }
+  return A;
+}
+
+struct rowsampler {
+  rowsampler(const index_t N) : generator(2), row(0, N - 1) {}
+  template <class RandomIt> void operator()(RandomIt first, RandomIt last) {
+    for (RandomIt it = first; it != last; ++it)
+      *it = row(generator);
+  }
+  mt19937 generator;
+  uniform_int_distribution<index_t> row;
+};
+
+struct nologger {
+  template <class InputIt>
+  void operator()(const index_t, const value_t, InputIt, InputIt,
+                  const value_t *) const {}
+};
+
+vector<value_t> dense(const csrview<value_t, index_t> &A,
+                      const parameters &p, vector<value_t> x,
+                      const index_t M, const index_t K) {
+  const size_t d = x.size();
+  vector<value_t> nu(d), v(d), vhat(d), g(d);
+  vector<index_t> rows(M);
+  rowsampler sampler(A.nrows);
+  const value_t tau = p.gamma * p.lambda;
+  for (index_t k = 0; k < K; k++) {
+    sampler(begin(rows), end(rows));
+    fill(begin(g), end(g), value_t{0});
+    for (const auto row : rows) {
+      value_t z{0};
+      for (index_t idx = A.rowptr[row]; idx < A.rowptr[row + 1]; idx++)
+        z += A.values[idx] * x[A.colind[idx]];
+      const value_t b = A.labels[row];
+      const value_t margin = -b * z;
+      const value_t e = exp(-abs(margin));
+      const value_t sigma = margin > 0 ? 1 / (1 + e) : e / (1 + e);
+      for (index_t idx = A.rowptr[row]; idx < A.rowptr[row + 1]; idx++)
+        g[A.colind[idx]] += -b * sigma * A.values[idx];
+    }
+    for (size_t j = 0; j < d; j++) {
+      nu[j] = p.mu * nu[j] + g[j];
+      v[j] = p.beta * v[j] + (1 - p.beta) * g[j] * g[j];
+      vhat[j] = max(vhat[j], v[j]);
+      const value_t y = x[j] - p.gamma * nu[j] / (sqrt(vhat[j]) + p.delta);
+      x[j] = y > tau ? y - tau : y < -tau ? y + tau : 0;
+    }
+  }
+  return x;
+}
+
+vector<value_t> lazy(const csrview<value_t, index_t> &A, const parameters &p,
+                     const vector<value_t> &x0, const index_t M,
+                     const index_t K) {
+  lazyamsgrad<value_t, index_t> alg;
+  alg.step_parameters(p.gamma);
+  alg.boosting_parameters(p.mu, 1);
+  alg.smoothing_parameters(p.beta, p.delta);
+  alg.prox_parameters(p.lambda);
+  alg.initialize(x0);
+  rowsampler sampler(A.nrows);
+  nologger logger;
+  alg.solve(A, sampler, M, logger, K);
+  return alg.getx();
+}
+
+int main() {
+  const index_t N{200}, d{400}, M{4}, K{300};
+  const csrmatrix<value_t, index_t> A = sparsematrix(N, d);
+  vector<value_t> x0(d);
+  mt19937 generator(3);
+  normal_distribution<value_t> dist(0, 1);
+  for (auto &val : x0)
+    val = dist(generator);
+
+  int failures{0};
+  for (const value_t mu : {0., 0.9, 1.})
+    /* tau = 0 up to a tau above the drifts (c <= tau) */
+    for (const value_t lambda : {0., 1e-3, 0.1, 1., 10.}) {
+      const parameters p{0.01, mu, 0.99, 1e-8, lambda};
+      const vector<value_t> expected = dense(A.view(), p, x0, M, K);
+      const vector<value_t> actual = lazy(A.view(), p, x0, M, K);
+      value_t error{0};
+      for (index_t j = 0; j < d; j++)
+        error = max(error, abs(actual[j] - expected[j]) /
+                               (1 + abs(expected[j])));
+      const bool ok = error < 1e-9;
+      cout << (ok ? "passed" : "FAILED") << ": mu = " << mu
+           << ", lambda1 = " << lambda << ", error = " << error << '\n';
+      failures += !ok;
+    }
+  return failures > 0;
+}
@@ -0,0 +1,91 @@
+#ifndef BATCHSAMPLER_HPP_
+#define BATCHSAMPLER_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "csr.hpp"
+#include "rng.hpp"
+
+/*
+ * Samples mini-batches of indices in {0, ..., n - 1} with replacement, as
+ * utility::sampler::uniform does, but reproducibly: the bth batch drawn from
+ * a sampler (and its copies) is a pure function of (seed, stream, b), so a
+ * fixed seed gives the same batches in the same order whatever else runs
+ * concurrently. Each batch is generated in one pass over counters and
+ * sorted, so that the rows are read in storage order.
+ *
+ * Given the CSR rows, each thread also prefetches the rows of the batch it
+ * expects to draw next, i.e., the one as many batches after its current one
+ * as it skipped since its previous one, while the current batch is being
+ * evaluated. The guess consumes no counter values: a thread that is handed
+ * another batch generates that one instead, so the batches a run sees do not
+ * depend on the number of threads.
+ */
+template <class value_t, class index_t> struct batchsampler {
+  batchsampler(const uint64_t seed, const uint64_t stream, const index_t n,
+               const csrview<value_t, index_t> *A = nullptr)
+      : gen(seed, stream), n{n}, A{A}, state(make_shared<shared>()) {}
+
+  template <class RandomIt> void operator()(RandomIt first, RandomIt last) {
+    const size_t m = size_t(last - first);
+    if (A == nullptr) {
+      generate(state->next++, m, &*first);
+      return;
+    }
+
+    thread_local struct {
+      uint64_t owner{0}, last{0}, ahead{0};
+      vector<index_t> batch;
+    } local;
+    const uint64_t b = state->next++;
+    const bool mine = local.owner == state->id;
+    if (mine && local.ahead == b && local.batch.size() == m)
+      copy(begin(local.batch), end(local.batch), first);
+    else
+      generate(b, m, &*first);
+    local.ahead = mine ? b + (b - local.last) : b + 1;
+    local.owner = state->id;
+    local.last = b;
+    local.batch.resize(m);
+    generate(local.ahead, m, &local.batch[0]);
+    prefetch(local.batch);
+  }
+
+private:
+  struct shared {
+    shared() : id{++ids} {}
+
+    static atomic<uint64_t> ids;
+    const uint64_t id;
+    atomic<uint64_t> next{0};
+  };
+
+  void generate(const uint64_t b, const size_t m, index_t *out) const {
+    gen.below(b * m, uint32_t(n), out, m);
+    sort(out, out + m);
+  }
+
+  /* the first cache line of each row's column indices and values */
+  void prefetch(const vector<index_t> &batch) const {
+    for (const auto row : batch) {
+      const index_t offset = A->rowptr[row];
+      __builtin_prefetch(A->colind + offset);
+      __builtin_prefetch(A->values + offset);
+      __builtin_prefetch(A->labels + row);
+    }
+  }
+
+  counterrng gen;
+  index_t n;
+  const csrview<value_t, index_t> *A;
+  shared_ptr<shared> state;
+};
+
+template <class value_t, class index_t>
+atomic<uint64_t> batchsampler<value_t, index_t>::shared::ids{0};
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef CSR_HPP_
+#define CSR_HPP_
+
+template <class value_t, class index_t> struct csrview {
+  index_t nrows{0}, ncols{0};
+  const index_t *rowptr{nullptr};
+  const index_t *colind{nullptr};
+  const value_t *values{nullptr};
+  const value_t *labels{nullptr};
+
+  index_t nnz() const noexcept { return nrows > 0 ? rowptr[nrows] : 0; }
+};
+
+template <class value_t, class index_t> struct csrmatrix {
+  csrmatrix() = default;
+  csrmatrix(const loss::data<value_t, index_t> &dataset)
+      : nrows{dataset.nsamples()}, ncols{dataset.nfeatures()} {
+    const auto &A = *dataset.matrix();
+    const auto &b = dataset.labels();
+    rowptr.reserve(size_t(nrows) + 1);
+    rowptr.push_back(0);
+    labels.resize(nrows);
+    for (index_t row = 0; row < nrows; row++) {
+      const auto rowvec = A.getrow(row);
+      const auto colind = A.colindices(row);
+      this->colind.insert(end(this->colind), begin(colind), end(colind));
+      values.insert(end(values), begin(rowvec), end(rowvec));
+      rowptr.push_back(index_t(values.size()));
+      labels[row] = b[row];
+    }
+  }
+
+  loss::data<value_t, index_t> todata() const & {
+    return loss::data<value_t, index_t>(
+        make_shared<utility::matrix::smatrix<value_t, index_t>>(
+            nrows, ncols, rowptr, colind, values),
+        labels);
+  }
+
+  loss::data<value_t, index_t> todata() && {
+    return loss::data<value_t, index_t>(
+        make_shared<utility::matrix::smatrix<value_t, index_t>>(
+            nrows, ncols, move(rowptr), move(colind), move(values)),
+        move(labels));
+  }
+
+  csrview<value_t, index_t> view() const noexcept {
+    csrview<value_t, index_t> v;
+    v.nrows = nrows;
+    v.ncols = ncols;
+    v.rowptr = rowptr.data();
+    v.colind = colind.data();
+    v.values = values.data();
+    v.labels = labels.data();
+    return v;
+  }
+
+  index_t nrows{0}, ncols{0};
+  vector<index_t> rowptr, colind;
+  vector<value_t> values, labels;
+};
+
+#endif
@@ -0,0 +1,105 @@
+#ifndef CSRFILE_HPP_
+#define CSRFILE_HPP_
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+
+#include "csr.hpp"
+#include "mappedfile.hpp"
+
+/*
+ * Read-only CSR file that can be mapped in place:
+ *
+ *   header: magic[8], version, reserved, nrows, ncols, nnz
+ *   arrays: rowptr[nrows + 1], colind[nnz], values[nnz], labels[nrows]
+ *
+ * Each array starts at a 64-byte aligned offset.
+ */
+namespace csrfile {
+constexpr char magic[8] = {'P', 'O', 'L', 'O', 'C', 'S', 'R', '\0'};
+constexpr uint32_t version = 1;
+constexpr size_t alignment = 64;
+
+inline size_t align(const size_t offset) {
+  return (offset + alignment - 1) / alignment * alignment;
+}
+
+template <class value_t, class index_t>
+void save(const csrview<value_t, index_t> &A, const string &filename) {
+  ofstream file(filename, ios_base::binary);
+  if (!file)
+    throw runtime_error(filename + " could not be opened.");
+
+  size_t offset{0};
+  auto put = [&](const void *data, const size_t bytes) {
+    file.write(static_cast<const char *>(data), bytes);
+    offset += bytes;
+  };
+  auto pad = [&]() {
+    const char zeros[alignment] = {};
+    put(zeros, align(offset) - offset);
+  };
+
+  const uint32_t reserved{0};
+  const int64_t nnz = A.nnz();
+  put(magic, 8);
+  put(&version, sizeof(version));
+  put(&reserved, sizeof(reserved));
+  put(&A.nrows, sizeof(index_t));
+  put(&A.ncols, sizeof(index_t));
+  put(&nnz, sizeof(nnz));
+  pad();
+  put(A.rowptr, (size_t(A.nrows) + 1) * sizeof(index_t));
+  pad();
+  put(A.colind, nnz * sizeof(index_t));
+  pad();
+  put(A.values, nnz * sizeof(value_t));
+  pad();
+  put(A.labels, A.nrows * sizeof(value_t));
+  if (!file)
+    throw runtime_error(filename + " could not be written.");
+}
+} // namespace csrfile
+
+template <class value_t, class index_t> struct mappedcsr {
+  mappedcsr() = default;
+  mappedcsr(const string &filename) : file(filename, MADV_RANDOM) {
+    const char *data = file.data();
+    const size_t header = 8 + 2 * sizeof(uint32_t) + 2 * sizeof(index_t) +
+                          sizeof(int64_t);
+    uint32_t fversion;
+    if (file.size() < header || memcmp(data, csrfile::magic, 8) != 0)
+      throw runtime_error(filename + " is not a CSR file.");
+    memcpy(&fversion, data + 8, sizeof(fversion));
+    if (fversion != csrfile::version)
+      throw runtime_error(filename + " has an unsupported version.");
+
+    int64_t nnz;
+    size_t offset = 8 + 2 * sizeof(uint32_t);
+    memcpy(&A.nrows, data + offset, sizeof(index_t));
+    memcpy(&A.ncols, data + offset + sizeof(index_t), sizeof(index_t));
+    memcpy(&nnz, data + offset + 2 * sizeof(index_t), sizeof(int64_t));
+
+    offset = csrfile::align(header);
+    A.rowptr = reinterpret_cast<const index_t *>(data + offset);
+    offset = csrfile::align(offset + (size_t(A.nrows) + 1) * sizeof(index_t));
+    A.colind = reinterpret_cast<const index_t *>(data + offset);
+    offset = csrfile::align(offset + nnz * sizeof(index_t));
+    A.values = reinterpret_cast<const value_t *>(data + offset);
+    offset = csrfile::align(offset + nnz * sizeof(value_t));
+    A.labels = reinterpret_cast<const value_t *>(data + offset);
+    offset += A.nrows * sizeof(value_t);
+    if (offset > file.size() || A.nnz() != nnz)
+      throw runtime_error(filename + " is truncated.");
+  }
+
+  const csrview<value_t, index_t> &view() const noexcept { return A; }
+  size_t size() const noexcept { return file.size(); }
+
+private:
+  mappedfile file;
+  csrview<value_t, index_t> A;
+};
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef CSRLOGISTIC_HPP_
+#define CSRLOGISTIC_HPP_
+
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <type_traits>
+
+#include "csr.hpp"
+
+/*
+ * Logistic loss summed over the (sampled) rows of a CSR view, with the same
+ * call signatures as loss::logistic. The view is not owned; the storage it
+ * points to (e.g. a mappedcsr) must outlive the loss.
+ */
+template <class value_t, class index_t> struct csrlogistic {
+  csrlogistic(const csrview<value_t, index_t> &A) : A(A) {}
+
+  index_t nsamples() const noexcept { return A.nrows; }
+  index_t nfeatures() const noexcept { return A.ncols; }
+
+  value_t operator()(const value_t *x, value_t *g) const {
+    fill(g, g + A.ncols, value_t{0});
+    double fval{0};
+    for (index_t row = 0; row < A.nrows; row++)
+      fval += accumulate(row, x, g);
+    return value_t(fval);
+  }
+
+  value_t operator()(const value_t *x, value_t *g, const index_t *ibegin,
+                     const index_t *iend) const {
+    fill(g, g + A.ncols, value_t{0});
+    double fval{0};
+    for (const index_t *it = ibegin; it != iend; it++)
+      fval += accumulate(*it, x, g);
+    return value_t(fval);
+  }
+
+private:
+  value_t accumulate(const index_t row, const value_t *x, value_t *g) const {
+    const index_t begin = A.rowptr[row], end = A.rowptr[row + 1];
+    value_t z{0};
+    for (index_t idx = begin; idx < end; idx++)
+      z += A.values[idx] * x[A.colind[idx]];
+    const value_t b = A.labels[row];
+    const value_t m = -b * z;
+    const value_t e = exp(-abs(m));
+    const value_t sigma = m > 0 ? 1 / (1 + e) : e / (1 + e);
+    const value_t scale = -b * sigma;
+    for (index_t idx = begin; idx < end; idx++)
+      g[A.colind[idx]] += scale * A.values[idx];
+    return m > 0 ? m + log1p(e) : log1p(e);
+  }
+
+  csrview<value_t, index_t> A;
+};
+
+/*
+ * Type-erased loss so that one solver instantiation serves both
+ * loss::logistic and csrlogistic.
+ */
+template <class value_t, class index_t> struct anyloss {
+  template <class Loss, class = typename enable_if<
+                            !is_same<Loss, anyloss>::value>::type>
+  anyloss(Loss loss) {
+    auto ptr = make_shared<Loss>(move(loss));
+    full = [ptr](const value_t *x, value_t *g) { return (*ptr)(x, g); };
+    partial = [ptr](const value_t *x, value_t *g, const index_t *ibegin,
+                    const index_t *iend) {
+      return (*ptr)(x, g, ibegin, iend);
+    };
+  }
+
+  value_t operator()(const value_t *x, value_t *g) const { return full(x, g); }
+  value_t operator()(const value_t *x, value_t *g, const index_t *ibegin,
+                     const index_t *iend) const {
+    return partial(x, g, ibegin, iend);
+  }
+
+private:
+  function<value_t(const value_t *, value_t *)> full;
+  function<value_t(const value_t *, value_t *, const index_t *, const index_t *)>
+      partial;
+};
+
+#endif
@@ -0,0 +1,176 @@
+#ifndef DSSTATS_HPP_
+#define DSSTATS_HPP_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <random>
+
+#include "csr.hpp"
+
+template <class value_t, class index_t> struct dsstats {
+  dsstats() = default;
+  dsstats(const csrview<value_t, index_t> &A, const int niters = 30)
+      : nsamples{A.nrows}, nfeatures{A.ncols}, nnz{A.nnz()},
+        rownorms(A.nrows), rownnz(A.nrows), colnnz(A.ncols) {
+    double sqnorms{0}, maxrowsum{0};
+    vector<double> colsums(A.ncols);
+    for (index_t row = 0; row < A.nrows; row++) {
+      double sqnorm{0}, rowsum{0};
+      for (index_t idx = A.rowptr[row]; idx < A.rowptr[row + 1]; idx++) {
+        sqnorm += double(A.values[idx]) * A.values[idx];
+        rowsum += abs(double(A.values[idx]));
+        colsums[A.colind[idx]] += abs(double(A.values[idx]));
+        colnnz[A.colind[idx]]++;
+      }
+      sqnorms += sqnorm;
+      maxrowsum = max(maxrowsum, rowsum);
+      rownorms[row] = value_t(sqrt(sqnorm));
+      rownnz[row] = A.rowptr[row + 1] - A.rowptr[row];
+      maxnorm = max(maxnorm, rownorms[row]);
+    }
+    const double maxcolsum =
+        colsums.empty() ? 0 : *max_element(begin(colsums), end(colsums));
+    frobenius = value_t(0.25 * sqnorms);
+    /* ||A||_2^2 <= ||A||_1 ||A||_inf */
+    lipschitzbound = min(frobenius, value_t(0.25 * maxcolsum * maxrowsum));
+    lipschitzestimate =
+        min(lipschitzbound, value_t(0.25 * spectral(A, niters)));
+  }
+
+  /* Lipschitz constant of the logistic loss summed over any M samples */
+  value_t batchlipschitz(const index_t M) const {
+    vector<value_t> sqnorms(rownorms.size());
+    transform(begin(rownorms), end(rownorms), begin(sqnorms),
+              [](const value_t norm) { return norm * norm; });
+    const size_t m = min(size_t(max(M, index_t(0))), sqnorms.size());
+    partial_sort(begin(sqnorms), begin(sqnorms) + m, end(sqnorms),
+                 greater<value_t>());
+    double sum{0};
+    for (size_t idx = 0; idx < m; idx++)
+      sum += sqnorms[idx];
+    return min(value_t(0.25 * sum), lipschitzbound);
+  }
+
+  value_t frequency(const index_t col) const {
+    return nsamples > 0 ? value_t(colnnz[col]) / nsamples : value_t{0};
+  }
+
+  void save(const string &filename) const {
+    ofstream file(filename, ios_base::binary);
+    if (!file)
+      throw runtime_error(filename + " could not be opened.");
+    auto put = [&](const void *data, const size_t bytes) {
+      file.write(static_cast<const char *>(data), bytes);
+    };
+    put(magic, 8);
+    put(&version, sizeof(version));
+    put(&nsamples, sizeof(index_t));
+    put(&nfeatures, sizeof(index_t));
+    put(&nnz, sizeof(int64_t));
+    put(&maxnorm, sizeof(value_t));
+    put(&frobenius, sizeof(value_t));
+    put(&lipschitzbound, sizeof(value_t));
+    put(&lipschitzestimate, sizeof(value_t));
+    put(rownorms.data(), rownorms.size() * sizeof(value_t));
+    put(rownnz.data(), rownnz.size() * sizeof(index_t));
+    put(colnnz.data(), colnnz.size() * sizeof(index_t));
+    if (!file)
+      throw runtime_error(filename + " could not be written.");
+  }
+
+  void load(const string &filename) {
+    ifstream file(filename, ios_base::binary);
+    if (!file)
+      throw runtime_error(filename + " could not be opened.");
+    auto get = [&](void *data, const size_t bytes) {
+      file.read(static_cast<char *>(data), bytes);
+    };
+    char buffer[8];
+    uint32_t fversion;
+    get(buffer, 8);
+    get(&fversion, sizeof(fversion));
+    if (!file || memcmp(buffer, magic, 8) != 0 || fversion != version)
+      throw runtime_error(filename + " is not a supported statistics file.");
+    get(&nsamples, sizeof(index_t));
+    get(&nfeatures, sizeof(index_t));
+    get(&nnz, sizeof(int64_t));
+    get(&maxnorm, sizeof(value_t));
+    get(&frobenius, sizeof(value_t));
+    get(&lipschitzbound, sizeof(value_t));
+    get(&lipschitzestimate, sizeof(value_t));
+    if (!file || nsamples < 0 || nfeatures < 0)
+      throw runtime_error(filename + " is truncated.");
+    rownorms.resize(nsamples);
+    rownnz.resize(nsamples);
+    colnnz.resize(nfeatures);
+    get(rownorms.data(), rownorms.size() * sizeof(value_t));
+    get(rownnz.data(), rownnz.size() * sizeof(index_t));
+    get(colnnz.data(), colnnz.size() * sizeof(index_t));
+    if (!file)
+      throw runtime_error(filename + " is truncated.");
+  }
+
+  index_t nsamples{0}, nfeatures{0};
+  int64_t nnz{0};
+  value_t maxnorm{0};
+  /*
+   * 0.25 * ||A||_F^2 and the smaller of it and 0.25 * ||A||_1 ||A||_inf bound
+   * the Lipschitz constant of the summed loss from above. The estimate of
+   * 0.25 * ||A||_2^2 by power iterations is a Rayleigh quotient, i.e., it can
+   * only fall short of the constant, and is kept for reference.
+   */
+  value_t frobenius{0}, lipschitzbound{0}, lipschitzestimate{0};
+  vector<value_t> rownorms;
+  vector<index_t> rownnz, colnnz;
+
+private:
+  /* Estimates the largest eigenvalue of A^T A by power iterations */
+  static double spectral(const csrview<value_t, index_t> &A, const int niters) {
+    if (A.nrows == 0 || A.ncols == 0)
+      return 0;
+    vector<double> v(A.ncols), w(A.ncols);
+    mt19937 gen(0);
+    uniform_real_distribution<double> uniform(0.5, 1);
+    for (auto &val : v)
+      val = uniform(gen);
+
+    double lambda{0};
+    for (int iter = 0; iter < niters; iter++) {
+      double norm{0};
+      for (const double val : v)
+        norm += val * val;
+      norm = sqrt(norm);
+      if (norm == 0)
+        return 0;
+      for (auto &val : v)
+        val /= norm;
+
+      fill(begin(w), end(w), 0);
+      for (index_t row = 0; row < A.nrows; row++) {
+        double z{0};
+        for (index_t idx = A.rowptr[row]; idx < A.rowptr[row + 1]; idx++)
+          z += A.values[idx] * v[A.colind[idx]];
+        for (index_t idx = A.rowptr[row]; idx < A.rowptr[row + 1]; idx++)
+          w[A.colind[idx]] += z * A.values[idx];
+      }
+      lambda = 0;
+      for (index_t col = 0; col < A.ncols; col++)
+        lambda += v[col] * w[col];
+      swap(v, w);
+    }
+    return lambda;
+  }
+
+  static constexpr char magic[8] = {'P', 'O', 'L', 'O', 'S', 'T', 'A', 'T'};
+  static constexpr uint32_t version = 3;
+};
+
+template <class value_t, class index_t>
+constexpr char dsstats<value_t, index_t>::magic[8];
+template <class value_t, class index_t>
+constexpr uint32_t dsstats<value_t, index_t>::version;
+
+#endif
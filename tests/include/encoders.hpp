@@ -0,0 +1,348 @@
+#ifndef ENCODERS_HPP_
+#define ENCODERS_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "csr.hpp"
+#include "iterlog.hpp"
+#include "rng.hpp"
+
+/*
+ * Encoders for the vectors exchanged between the parameter server's master
+ * and workers, in place of encoder::identity. A message is a byte string
+ * that starts with its format, so any encoder decodes any message back into
+ * the full d-dimensional vector. Copies of an encoder share counters of the
+ * messages and bytes they have produced, and the vectors the senders of
+ * delta messages hold on this side.
+ */
+namespace encoders {
+enum format : uint8_t {
+  denseformat = 0,
+  sparseformat = 1,
+  quantizedformat = 2,
+  halfformat = 3,
+  deltaformat = 4
+};
+
+struct counters {
+  atomic<uint64_t> messages{0}, bytes{0};
+};
+
+inline uint16_t tohalf(const float val) {
+  uint32_t x;
+  memcpy(&x, &val, sizeof(x));
+  const uint16_t sign = uint16_t((x >> 16) & 0x8000);
+  x &= 0x7FFFFFFF;
+  if (x >= 0x47800000) /* overflows, infinite or NaN */
+    return sign | (x > 0x7F800000 ? 0x7E00 : 0x7C00);
+  if (x < 0x38800000) /* subnormal in half precision */
+    return sign | uint16_t(nearbyint(fabs(val) * 16777216.f));
+  x -= 112u << 23;
+  return sign | uint16_t((x + 0x0FFF + ((x >> 13) & 1)) >> 13);
+}
+
+inline float fromhalf(const uint16_t h) {
+  const uint32_t sign = uint32_t(h & 0x8000) << 16;
+  const uint32_t exponent = (h >> 10) & 0x1F, mantissa = h & 0x3FF;
+  if (exponent == 0) {
+    const float val = ldexp(float(mantissa), -24);
+    return sign ? -val : val;
+  }
+  const uint32_t x = sign | (mantissa << 13) |
+                     (exponent == 31 ? 0x7F800000 : (exponent + 112) << 23);
+  float val;
+  memcpy(&val, &x, sizeof(val));
+  return val;
+}
+
+/* Decodes a message of any of the encoders below but topk */
+template <class value_t, class OutputIt>
+OutputIt decode(const string &message, OutputIt first) {
+  const char *ptr = message.data();
+  const uint8_t fmt = iterlog::getraw<uint8_t>(ptr);
+  const uint32_t d = iterlog::getvarint(ptr);
+  if (fmt == denseformat)
+    for (uint32_t idx = 0; idx < d; idx++)
+      first[idx] = iterlog::getraw<value_t>(ptr);
+  else if (fmt == sparseformat) {
+    const uint32_t count = iterlog::getvarint(ptr);
+    fill(first, first + d, value_t{0});
+    uint32_t idx{0};
+    for (uint32_t n = 0; n < count; n++) {
+      idx += iterlog::getvarint(ptr);
+      first[idx] = iterlog::getraw<value_t>(ptr);
+    }
+  } else if (fmt == quantizedformat) {
+    const uint32_t bits = iterlog::getvarint(ptr);
+    const value_t step = iterlog::getraw<value_t>(ptr);
+    for (uint32_t idx = 0; idx < d; idx++)
+      if (bits == 8)
+        first[idx] = step * int8_t(ptr[idx]);
+      else {
+        const uint8_t nibble = uint8_t(ptr[idx / 2]) >> (4 * (idx % 2)) & 0xF;
+        first[idx] = step * (int(nibble) - 8);
+      }
+  } else if (fmt == halfformat)
+    for (uint32_t idx = 0; idx < d; idx++)
+      first[idx] = value_t(fromhalf(iterlog::getraw<uint16_t>(ptr)));
+  else if (fmt == deltaformat)
+    throw runtime_error("delta messages need the vector of their sender");
+  else
+    throw runtime_error("unknown message format " + to_string(int(fmt)));
+  return first + d;
+}
+
+/* The last vector received from each sender of delta messages */
+template <class value_t> struct senders {
+  mutex mu;
+  map<uint32_t, vector<value_t>> vectors;
+};
+
+template <class value_t, class index_t> struct encoder {
+  encoder(vector<index_t> columns = {})
+      : columns(make_shared<const vector<index_t>>(move(columns))),
+        stats(make_shared<counters>()),
+        received(make_shared<senders<value_t>>()) {}
+
+  template <class OutputIt>
+  OutputIt decode(const string &message, OutputIt first) const {
+    if (message.empty() || uint8_t(message[0]) != deltaformat)
+      return encoders::decode<value_t>(message, first);
+    const char *ptr = message.data() + 1;
+    const uint32_t d = iterlog::getvarint(ptr);
+    const uint32_t sender = iterlog::getvarint(ptr);
+    const uint32_t count = iterlog::getvarint(ptr);
+    lock_guard<mutex> lock(received->mu);
+    vector<value_t> &g = received->vectors[sender];
+    g.resize(d);
+    uint32_t idx{0};
+    for (uint32_t n = 0; n < count; n++) {
+      idx += iterlog::getvarint(ptr);
+      g[idx] = iterlog::getraw<value_t>(ptr);
+    }
+    return copy(begin(g), end(g), first);
+  }
+
+  uint64_t messages() const noexcept { return stats->messages; }
+  uint64_t bytes() const noexcept { return stats->bytes; }
+
+protected:
+  string header(const format fmt, const index_t d) const {
+    string buffer;
+    iterlog::putraw(buffer, uint8_t(fmt));
+    iterlog::putvarint(buffer, uint32_t(d));
+    return buffer;
+  }
+
+  string count(string message) const {
+    stats->messages++;
+    stats->bytes += message.size();
+    return message;
+  }
+
+  /* the columns that can be nonzero, all when empty */
+  shared_ptr<const vector<index_t>> columns;
+  shared_ptr<counters> stats;
+  shared_ptr<senders<value_t>> received;
+};
+
+/* All entries as raw values, like encoder::identity */
+template <class value_t, class index_t>
+struct dense : encoder<value_t, index_t> {
+  using encoder<value_t, index_t>::encoder;
+
+  template <class InputIt> string encode(InputIt first, InputIt last) const {
+    const index_t d = index_t(last - first);
+    string buffer = this->header(denseformat, d);
+    buffer.reserve(buffer.size() + sizeof(value_t) * size_t(d));
+    for (InputIt it = first; it != last; ++it)
+      iterlog::putraw(buffer, value_t(*it));
+    return this->count(buffer);
+  }
+};
+
+/*
+ * Nonzero entries as varint index gaps and raw values (cf. iterlog's sparse
+ * payloads). Given the columns a worker's shard touches, only those entries
+ * are scanned, since the gradient is zero elsewhere.
+ */
+template <class value_t, class index_t>
+struct sparse : encoder<value_t, index_t> {
+  using encoder<value_t, index_t>::encoder;
+
+  template <class InputIt> string encode(InputIt first, InputIt last) const {
+    const index_t d = index_t(last - first);
+    string entries;
+    index_t count{0}, previous{0};
+    auto put = [&](const index_t idx, const value_t val) {
+      if (val == 0)
+        return;
+      iterlog::putvarint(entries, uint32_t(idx - previous));
+      iterlog::putraw(entries, val);
+      previous = idx;
+      count++;
+    };
+    if (this->columns->empty())
+      for (index_t idx = 0; idx < d; idx++)
+        put(idx, first[idx]);
+    else
+      for (const auto idx : *this->columns)
+        put(idx, first[idx]);
+    string buffer = this->header(sparseformat, d);
+    iterlog::putvarint(buffer, uint32_t(count));
+    return this->count(buffer + entries);
+  }
+};
+
+/*
+ * Stochastic quantization to 8 or 4 bits: each entry is rounded up or down
+ * to a multiple of max|g| / (2^(bits - 1) - 1) with the probabilities that
+ * make the rounding unbiased.
+ */
+template <class value_t, class index_t>
+struct quantized : encoder<value_t, index_t> {
+  quantized(const int bits, const uint64_t seed, const uint64_t stream,
+            vector<index_t> columns = {})
+      : encoder<value_t, index_t>(move(columns)), bits{bits},
+        gen(seed, stream), next(make_shared<atomic<uint64_t>>(0)) {}
+
+  template <class InputIt> string encode(InputIt first, InputIt last) const {
+    const index_t d = index_t(last - first);
+    const int levels = (1 << (bits - 1)) - 1;
+    value_t maxabs{0};
+    for (InputIt it = first; it != last; ++it)
+      maxabs = max(maxabs, value_t(abs(*it)));
+    const value_t step = maxabs > 0 ? maxabs / levels : value_t{1};
+
+    const uint64_t counter = (*next)++ * uint64_t(d);
+    string codes(bits == 8 ? d : (d + 1) / 2, char(bits == 8 ? 0 : 0x88));
+    auto quantize = [&](const index_t idx) {
+      const double scaled = first[idx] / step;
+      const int code = int(floor(scaled + gen.uniform(counter + idx)));
+      if (bits == 8)
+        codes[idx] = char(int8_t(code));
+      else {
+        const int shift = 4 * (idx % 2);
+        codes[idx / 2] = char((uint8_t(codes[idx / 2]) & ~(0xF << shift)) |
+                              (uint8_t(code + 8) << shift));
+      }
+    };
+    if (this->columns->empty())
+      for (index_t idx = 0; idx < d; idx++)
+        quantize(idx);
+    else
+      for (const auto idx : *this->columns)
+        quantize(idx);
+
+    string buffer = this->header(quantizedformat, d);
+    iterlog::putvarint(buffer, uint32_t(bits));
+    iterlog::putraw(buffer, step);
+    return this->count(buffer + codes);
+  }
+
+private:
+  int bits;
+  counterrng gen;
+  shared_ptr<atomic<uint64_t>> next;
+};
+
+/*
+ * The k entries that changed the most since the vector the receiver holds,
+ * as varint index gaps and their new values. The receiver keeps the last
+ * vector of each sender and overwrites the entries sent, so the master's
+ * aggregated gradient stays the sum of what it holds for the workers, and an
+ * entry left out keeps its error until it is among the k largest changes
+ * (error feedback for gradients that replace, rather than add to, the
+ * previous ones).
+ */
+template <class value_t, class index_t>
+struct topk : encoder<value_t, index_t> {
+  topk(const double fraction, const index_t d, const uint32_t sender,
+       vector<index_t> columns = {})
+      : encoder<value_t, index_t>(move(columns)), fraction{fraction},
+        sender{sender}, sent(make_shared<vector<value_t>>(d)) {}
+
+  template <class InputIt> string encode(InputIt first, InputIt last) const {
+    const index_t d = index_t(last - first);
+    vector<value_t> &held = *sent;
+    vector<index_t> candidates;
+    if (this->columns->empty()) {
+      candidates.resize(d);
+      for (index_t idx = 0; idx < d; idx++)
+        candidates[idx] = idx;
+    } else
+      candidates = *this->columns;
+
+    const size_t k =
+        min(candidates.size(), size_t(ceil(fraction * candidates.size())));
+    nth_element(begin(candidates), begin(candidates) + k, end(candidates),
+                [&](const index_t lhs, const index_t rhs) {
+                  return abs(value_t(first[lhs]) - held[lhs]) >
+                         abs(value_t(first[rhs]) - held[rhs]);
+                });
+    candidates.resize(k);
+    sort(begin(candidates), end(candidates));
+
+    string entries;
+    index_t count{0}, previous{0};
+    for (const auto idx : candidates) {
+      const value_t val = value_t(first[idx]);
+      if (val == held[idx])
+        continue;
+      iterlog::putvarint(entries, uint32_t(idx - previous));
+      iterlog::putraw(entries, val);
+      held[idx] = val;
+      previous = idx;
+      count++;
+    }
+    string buffer = this->header(deltaformat, d);
+    iterlog::putvarint(buffer, sender);
+    iterlog::putvarint(buffer, uint32_t(count));
+    return this->count(buffer + entries);
+  }
+
+private:
+  double fraction;
+  uint32_t sender;
+  shared_ptr<vector<value_t>> sent; /* as held by the receiver */
+};
+
+/* All entries in IEEE half precision */
+template <class value_t, class index_t>
+struct half : encoder<value_t, index_t> {
+  using encoder<value_t, index_t>::encoder;
+
+  template <class InputIt> string encode(InputIt first, InputIt last) const {
+    const index_t d = index_t(last - first);
+    string buffer = this->header(halfformat, d);
+    buffer.reserve(buffer.size() + 2 * size_t(d));
+    for (InputIt it = first; it != last; ++it)
+      iterlog::putraw(buffer, tohalf(float(*it)));
+    return this->count(buffer);
+  }
+};
+} // namespace encoders
+
+/* Columns with at least one nonzero, in increasing order */
+template <class value_t, class index_t>
+vector<index_t> touchedcolumns(const csrview<value_t, index_t> &A) {
+  vector<bool> touched(A.ncols);
+  for (index_t idx = 0; idx < A.nnz(); idx++)
+    touched[A.colind[idx]] = true;
+  vector<index_t> columns;
+  for (index_t col = 0; col < A.ncols; col++)
+    if (touched[col])
+      columns.push_back(col);
+  return columns;
+}
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef EVALUATOR_HPP_
+#define EVALUATOR_HPP_
+
+#include "csr.hpp"
+
+/*
+ * Evaluates the l1-regularized logistic loss of up to `k` iterates at once.
+ * The iterates are stacked into a row-major d x k block so that a single pass
+ * over the sparse matrix computes all the margins A * X. No gradient is formed.
+ */
+template <class value_t, class index_t> struct blockevaluator {
+  blockevaluator(const csrview<value_t, index_t> &A, const index_t k)
+      : A(A), k{k}, X(size_t(A.ncols) * k), z(k), fval(k), l1(k),
+        maxabs(k), nnz(k) {}
+
+  index_t capacity() const noexcept { return k; }
+
+  void set(const index_t col, const value_t *x) {
+    for (index_t row = 0; row < A.ncols; row++)
+      X[size_t(row) * k + col] = x[row];
+  }
+
+  void evaluate(const index_t ncols, const value_t lambda1,
+                const value_t threshold) {
+    fill(begin(fval), begin(fval) + ncols, 0);
+    for (index_t row = 0; row < A.nrows; row++) {
+      fill(begin(z), begin(z) + ncols, 0);
+      for (index_t idx = A.rowptr[row]; idx < A.rowptr[row + 1]; idx++) {
+        const value_t a = A.values[idx];
+        const value_t *xrow = &X[size_t(A.colind[idx]) * k];
+        for (index_t col = 0; col < ncols; col++)
+          z[col] += a * xrow[col];
+      }
+      const value_t b = A.labels[row];
+      for (index_t col = 0; col < ncols; col++) {
+        const value_t m = -b * z[col];
+        fval[col] += m > 0 ? m + log1p(exp(-m)) : log1p(exp(m));
+      }
+    }
+
+    fill(begin(l1), begin(l1) + ncols, 0);
+    fill(begin(maxabs), begin(maxabs) + ncols, 0);
+    for (index_t row = 0; row < A.ncols; row++) {
+      const value_t *xrow = &X[size_t(row) * k];
+      for (index_t col = 0; col < ncols; col++) {
+        const value_t absval = abs(xrow[col]);
+        l1[col] += absval;
+        maxabs[col] = max(maxabs[col], absval);
+      }
+    }
+
+    fill(begin(nnz), begin(nnz) + ncols, 0);
+    for (index_t row = 0; row < A.ncols; row++) {
+      const value_t *xrow = &X[size_t(row) * k];
+      for (index_t col = 0; col < ncols; col++)
+        nnz[col] += abs(xrow[col]) >= threshold * maxabs[col];
+    }
+
+    for (index_t col = 0; col < ncols; col++)
+      fval[col] += lambda1 * l1[col];
+  }
+
+  value_t getf(const index_t col) const { return value_t(fval[col]); }
+  index_t getnnz(const index_t col) const { return nnz[col]; }
+
+private:
+  csrview<value_t, index_t> A;
+  index_t k;
+  vector<value_t> X, z;
+  vector<double> fval, l1;
+  vector<value_t> maxabs;
+  vector<index_t> nnz;
+};
+
+#endif
@@ -0,0 +1,186 @@
+#ifndef INSTRUMENT_HPP_
+#define INSTRUMENT_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <utility>
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/*
+ * Per-thread hardware counters (cycles, instructions, LLC misses) read as one
+ * perf_event group. When the kernel refuses perf_event_open (e.g., due to
+ * perf_event_paranoid or in containers), the counters stay unavailable and
+ * only the timings are recorded.
+ */
+struct perfcounters {
+  static constexpr size_t nevents = 3;
+
+  perfcounters() {
+    const uint64_t configs[nevents] = {PERF_COUNT_HW_CPU_CYCLES,
+                                       PERF_COUNT_HW_INSTRUCTIONS,
+                                       PERF_COUNT_HW_CACHE_MISSES};
+    for (size_t idx = 0; idx < nevents; idx++) {
+      perf_event_attr attr;
+      memset(&attr, 0, sizeof(attr));
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.size = sizeof(attr);
+      attr.config = configs[idx];
+      attr.read_format = PERF_FORMAT_GROUP;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      fds[idx] = int(::syscall(SYS_perf_event_open, &attr, 0, -1,
+                               idx == 0 ? -1 : fds[0], 0));
+      if (fds[idx] < 0) {
+        close();
+        return;
+      }
+    }
+  }
+  perfcounters(const perfcounters &) = delete;
+  perfcounters &operator=(const perfcounters &) = delete;
+  ~perfcounters() { close(); }
+
+  bool available() const noexcept { return fds[0] >= 0; }
+
+  bool read(uint64_t *values) const noexcept {
+    uint64_t buffer[1 + nevents];
+    if (!available() ||
+        ::read(fds[0], buffer, sizeof(buffer)) != ssize_t(sizeof(buffer)))
+      return false;
+    memcpy(values, buffer + 1, sizeof(uint64_t) * nevents);
+    return true;
+  }
+
+  /* counters of the calling thread */
+  static const perfcounters &local() {
+    thread_local perfcounters counters;
+    return counters;
+  }
+
+private:
+  void close() noexcept {
+    for (auto &fd : fds)
+      if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+      }
+  }
+
+  int fds[nevents] = {-1, -1, -1};
+};
+
+struct phase {
+  phase(const string &name, const bool enabled, const bool counters)
+      : name{name}, enabled{enabled}, counters{counters} {}
+
+  const string name;
+  const bool enabled, counters;
+  atomic<uint64_t> calls{0}, ns{0}, events[perfcounters::nevents]{};
+  atomic<bool> counted{false};
+};
+
+/* Adds the time (and the counter deltas) until destruction to a phase */
+struct scope {
+  scope(phase *p) : p{p && p->enabled ? p : nullptr} {
+    if (this->p == nullptr)
+      return;
+    counted = p->counters && perfcounters::local().read(start);
+    tstart = chrono::steady_clock::now();
+  }
+  scope(const scope &) = delete;
+  scope &operator=(const scope &) = delete;
+  ~scope() {
+    if (p == nullptr)
+      return;
+    const auto tend = chrono::steady_clock::now();
+    uint64_t end[perfcounters::nevents];
+    if (counted && perfcounters::local().read(end)) {
+      for (size_t idx = 0; idx < perfcounters::nevents; idx++)
+        p->events[idx].fetch_add(end[idx] - start[idx],
+                                 memory_order_relaxed);
+      p->counted.store(true, memory_order_relaxed);
+    }
+    p->ns.fetch_add(
+        chrono::duration_cast<chrono::nanoseconds>(tend - tstart).count(),
+        memory_order_relaxed);
+    p->calls.fetch_add(1, memory_order_relaxed);
+  }
+
+private:
+  phase *p;
+  bool counted{false};
+  uint64_t start[perfcounters::nevents];
+  chrono::steady_clock::time_point tstart;
+};
+
+/*
+ * Named phases of an experiment. A disabled profiler hands out phases that
+ * are never timed, so instrumented code paths are the same either way.
+ */
+struct profiler {
+  profiler(const bool enabled, const bool counters = true)
+      : enabled{enabled}, counters{enabled && counters &&
+                                   perfcounters::local().available()} {}
+
+  phase *operator[](const string &name) {
+    lock_guard<mutex> lock(mu);
+    for (auto &p : phases)
+      if (p.name == name)
+        return &p;
+    phases.emplace_back(name, enabled, counters);
+    return &phases.back();
+  }
+
+  bool hascounters() const noexcept { return counters; }
+
+  void save(const string &filename) const {
+    ofstream file(filename);
+    if (!file)
+      throw runtime_error(filename + " could not be opened.");
+    file << "phase,calls,ns,cycles,instructions,llc-misses\n";
+    lock_guard<mutex> lock(mu);
+    for (const auto &p : phases) {
+      file << p.name << ',' << p.calls << ',' << p.ns;
+      for (const auto &event : p.events)
+        if (p.counted)
+          file << ',' << event;
+        else
+          file << ',';
+      file << '\n';
+    }
+    if (!file)
+      throw runtime_error(filename + " could not be written.");
+  }
+
+private:
+  const bool enabled, counters;
+  mutable mutex mu;
+  deque<phase> phases;
+};
+
+/* Forwards calls to a callable (loss, logger) and times them in a phase */
+template <class F> struct instrumented {
+  template <class... Args>
+  auto operator()(Args &&... args) const
+      -> decltype(declval<F &>()(forward<Args>(args)...)) {
+    const scope s(p);
+    return (*f)(forward<Args>(args)...);
+  }
+
+  F *f;
+  phase *p;
+};
+
+template <class F> instrumented<F> instrument(F &f, phase *p) {
+  return instrumented<F>{&f, p};
+}
+
+#endif
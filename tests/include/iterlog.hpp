@@ -0,0 +1,317 @@
+#ifndef ITERLOG_HPP_
+#define ITERLOG_HPP_
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <type_traits>
+
+#include "mappedfile.hpp"
+
+/*
+ * Iterate log format (version 1):
+ *
+ *   header : magic[8], version, flags, lambda1, d, keyinterval, reserved
+ *   entries: k, t, encoding, payload
+ *   index  : (offset, k, t) per entry
+ *   trailer: index offset, numlogs, reserved, magic[8]
+ *
+ * Payloads are either dense (d values), sparse (varint count followed by
+ * varint index gaps and raw values of the nonzeros) or, when delta encoding
+ * is enabled, the sparse set of words that differ from the previous entry
+ * under XOR. Every `keyinterval`th entry is self-contained.
+ */
+namespace iterlog {
+constexpr char magic[8] = {'P', 'O', 'L', 'O', 'L', 'O', 'G', '\0'};
+constexpr uint32_t version = 1;
+constexpr uint32_t deltaflag = 1;
+constexpr size_t headersize = 32;
+constexpr size_t indexsize = 16;
+constexpr size_t trailersize = 24;
+
+enum encoding : uint8_t { dense = 0, sparse = 1, delta = 2 };
+
+inline void putvarint(string &buffer, uint32_t val) {
+  while (val >= 0x80) {
+    buffer.push_back(char((val & 0x7F) | 0x80));
+    val >>= 7;
+  }
+  buffer.push_back(char(val));
+}
+
+inline uint32_t getvarint(const char *&ptr) {
+  uint32_t val{0};
+  int shift{0};
+  uint8_t byte;
+  do {
+    byte = uint8_t(*ptr++);
+    val |= uint32_t(byte & 0x7F) << shift;
+    shift += 7;
+  } while (byte & 0x80);
+  return val;
+}
+
+template <class T> void putraw(string &buffer, const T &val) {
+  buffer.append(reinterpret_cast<const char *>(&val), sizeof(T));
+}
+
+template <class T> T getraw(const char *&ptr) {
+  T val;
+  memcpy(&val, ptr, sizeof(T));
+  ptr += sizeof(T);
+  return val;
+}
+
+inline bool islog(const char *data, const size_t size) {
+  return size >= headersize + trailersize && memcmp(data, magic, 8) == 0;
+}
+
+inline bool islog(const string &filename) {
+  ifstream file(filename, ios_base::binary);
+  char buffer[8];
+  return file.read(buffer, 8) && memcmp(buffer, magic, 8) == 0;
+}
+} // namespace iterlog
+
+template <class value_t, class index_t> struct logwriter {
+  using word_t = typename conditional<sizeof(value_t) == 4, uint32_t,
+                                      uint64_t>::type;
+
+  logwriter(const string &filename, const value_t lambda1, const index_t d,
+            const bool delta = false, const index_t keyinterval = 64)
+      : file(filename, ios_base::binary), d{d}, delta{delta},
+        keyinterval{keyinterval > 0 ? keyinterval : 1}, previous(d) {
+    if (!file)
+      throw runtime_error(filename + " could not be opened.");
+    const uint32_t flags = delta ? iterlog::deltaflag : 0;
+    const uint32_t reserved{0};
+    string header(iterlog::magic, 8);
+    iterlog::putraw(header, iterlog::version);
+    iterlog::putraw(header, flags);
+    iterlog::putraw(header, lambda1);
+    iterlog::putraw(header, d);
+    iterlog::putraw(header, this->keyinterval);
+    iterlog::putraw(header, reserved);
+    emit(header);
+  }
+
+  logwriter(const logwriter &) = delete;
+  logwriter &operator=(const logwriter &) = delete;
+
+  ~logwriter() {
+    try {
+      close();
+    } catch (...) {
+    }
+  }
+
+  template <class InputIt> void write(const index_t k, const value_t t,
+                                      InputIt xbegin) {
+    current.assign(xbegin, xbegin + d);
+
+    const bool keyframe = !delta || index.size() % keyinterval == 0;
+    sparsebuffer.clear();
+    index_t nnz{0};
+    for (const value_t val : current)
+      nnz += val != 0;
+    iterlog::putvarint(sparsebuffer, nnz);
+    index_t last{0};
+    for (index_t idx = 0; idx < d; idx++)
+      if (current[idx] != 0) {
+        iterlog::putvarint(sparsebuffer, idx - last);
+        iterlog::putraw(sparsebuffer, current[idx]);
+        last = idx;
+      }
+
+    const string *payload = &sparsebuffer;
+    uint8_t enc = iterlog::sparse;
+    if (sparsebuffer.size() >= d * sizeof(value_t)) {
+      densebuffer.assign(reinterpret_cast<const char *>(&current[0]),
+                         d * sizeof(value_t));
+      payload = &densebuffer;
+      enc = iterlog::dense;
+    }
+
+    if (!keyframe) {
+      deltabuffer.clear();
+      index_t nchanged{0};
+      for (index_t idx = 0; idx < d; idx++)
+        nchanged += bits(current[idx]) != bits(previous[idx]);
+      iterlog::putvarint(deltabuffer, nchanged);
+      last = 0;
+      for (index_t idx = 0; idx < d; idx++) {
+        const word_t word = bits(current[idx]) ^ bits(previous[idx]);
+        if (word != 0) {
+          iterlog::putvarint(deltabuffer, idx - last);
+          iterlog::putraw(deltabuffer, word);
+          last = idx;
+        }
+      }
+      if (deltabuffer.size() < payload->size()) {
+        payload = &deltabuffer;
+        enc = iterlog::delta;
+      }
+    }
+
+    index.emplace_back(offset, k, t);
+    string entry;
+    iterlog::putraw(entry, k);
+    iterlog::putraw(entry, t);
+    iterlog::putraw(entry, enc);
+    emit(entry);
+    emit(*payload);
+    swap(previous, current);
+  }
+
+  void close() {
+    if (!file.is_open())
+      return;
+    const int64_t indexoffset = offset;
+    string buffer;
+    for (const auto &entry : index) {
+      iterlog::putraw(buffer, get<0>(entry));
+      iterlog::putraw(buffer, get<1>(entry));
+      iterlog::putraw(buffer, get<2>(entry));
+    }
+    const index_t numlogs = index.size();
+    const uint32_t reserved{0};
+    iterlog::putraw(buffer, indexoffset);
+    iterlog::putraw(buffer, numlogs);
+    iterlog::putraw(buffer, reserved);
+    buffer.append(iterlog::magic, 8);
+    emit(buffer);
+    file.close();
+  }
+
+  index_t size() const noexcept { return index.size(); }
+  int64_t bytes() const noexcept { return offset; }
+
+private:
+  static word_t bits(const value_t val) {
+    word_t word;
+    memcpy(&word, &val, sizeof(word_t));
+    return word;
+  }
+
+  void emit(const string &buffer) {
+    file.write(buffer.data(), buffer.size());
+    offset += buffer.size();
+  }
+
+  ofstream file;
+  index_t d;
+  bool delta;
+  index_t keyinterval;
+  int64_t offset{0};
+  vector<value_t> previous, current;
+  string sparsebuffer, densebuffer, deltabuffer;
+  vector<tuple<int64_t, index_t, value_t>> index;
+};
+
+template <class value_t, class index_t> struct logreader {
+  using word_t = typename logwriter<value_t, index_t>::word_t;
+
+  logreader(const string &filename) : file(filename) {
+    const char *data = file.data();
+    if (!iterlog::islog(data, file.size()))
+      throw runtime_error(filename + " is not an iterate log.");
+
+    const char *ptr = data + 8;
+    if (iterlog::getraw<uint32_t>(ptr) != iterlog::version)
+      throw runtime_error(filename + " has an unsupported version.");
+    ptr += sizeof(uint32_t);
+    lambda1_ = iterlog::getraw<value_t>(ptr);
+    d = iterlog::getraw<index_t>(ptr);
+
+    ptr = data + file.size() - iterlog::trailersize;
+    const int64_t indexoffset = iterlog::getraw<int64_t>(ptr);
+    N = iterlog::getraw<index_t>(ptr);
+    if (memcmp(data + file.size() - 8, iterlog::magic, 8) != 0 ||
+        indexoffset < int64_t(iterlog::headersize) ||
+        size_t(indexoffset) + N * iterlog::indexsize + iterlog::trailersize !=
+            file.size())
+      throw runtime_error(filename + " has a corrupt index.");
+    index = data + indexoffset;
+  }
+
+  value_t lambda1() const noexcept { return lambda1_; }
+  index_t dimension() const noexcept { return d; }
+  index_t size() const noexcept { return N; }
+
+  index_t getk(const index_t n) const {
+    const char *ptr = index + n * iterlog::indexsize + sizeof(int64_t);
+    return iterlog::getraw<index_t>(ptr);
+  }
+  value_t gett(const index_t n) const {
+    const char *ptr =
+        index + n * iterlog::indexsize + sizeof(int64_t) + sizeof(index_t);
+    return iterlog::getraw<value_t>(ptr);
+  }
+
+  index_t find(const index_t k) const {
+    index_t lo{0}, hi{N};
+    while (lo < hi) {
+      const index_t mid = lo + (hi - lo) / 2;
+      if (getk(mid) < k)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    return lo;
+  }
+
+  /*
+   * Decodes the nth entry into x. When x already holds the decoded entry
+   * `previous`, sequential reads only apply the deltas in between.
+   */
+  void read(const index_t n, value_t *x, const index_t previous = -1) const {
+    index_t start = n;
+    while (encoding(start) == iterlog::delta)
+      start--;
+    if (previous >= start && previous < n)
+      start = previous + 1;
+    for (index_t m = start; m <= n; m++)
+      apply(m, x);
+  }
+
+private:
+  const char *entry(const index_t n) const {
+    const char *ptr = index + n * iterlog::indexsize;
+    return file.data() + iterlog::getraw<int64_t>(ptr);
+  }
+
+  uint8_t encoding(const index_t n) const {
+    return uint8_t(entry(n)[sizeof(index_t) + sizeof(value_t)]);
+  }
+
+  void apply(const index_t n, value_t *x) const {
+    const char *ptr = entry(n) + sizeof(index_t) + sizeof(value_t);
+    const uint8_t enc = uint8_t(*ptr++);
+    if (enc == iterlog::dense) {
+      memcpy(x, ptr, d * sizeof(value_t));
+      return;
+    }
+    if (enc == iterlog::sparse)
+      fill(x, x + d, value_t{0});
+    const index_t count = iterlog::getvarint(ptr);
+    index_t idx{0};
+    for (index_t m = 0; m < count; m++) {
+      idx += iterlog::getvarint(ptr);
+      if (enc == iterlog::sparse)
+        x[idx] = iterlog::getraw<value_t>(ptr);
+      else {
+        word_t word;
+        memcpy(&word, &x[idx], sizeof(word_t));
+        word ^= iterlog::getraw<word_t>(ptr);
+        memcpy(&x[idx], &word, sizeof(word_t));
+      }
+    }
+  }
+
+  mappedfile file;
+  const char *index{nullptr};
+  value_t lambda1_;
+  index_t d, N;
+};
+
+#endif
@@ -0,0 +1,221 @@
+#ifndef LAZYAMSGRAD_HPP_
+#define LAZYAMSGRAD_HPP_
+
+#include <cmath>
+#include <cstddef>
+#include <iterator>
+#include <vector>
+
+#include "csr.hpp"
+
+/*
+ * Mini-batch proximal AMSGrad on the logistic loss of a CSR matrix,
+ *
+ *   nu   = mu * nu + epsilon * g
+ *   v    = beta * v + (1 - beta) * g^2,  vhat = max(vhat, v)
+ *   x    = prox_{gamma * lambda * |.|_1}(x - gamma * nu / (sqrt(vhat) + delta))
+ *
+ * where g is the gradient summed over the sampled rows. A coordinate that
+ * no sampled row touches has g = 0, so its nu and v decay geometrically,
+ * vhat stays put, and x follows a soft-thresholded geometric drift. Such
+ * coordinates are only brought up to date, in closed form, when they are
+ * next read, which makes an iteration O(nnz of the mini-batch) instead of
+ * O(d). The logger sees x through iterators that do the same.
+ */
+template <class value_t, class index_t> struct lazyamsgrad {
+  struct iterator {
+    using iterator_category = forward_iterator_tag;
+    using value_type = value_t;
+    using difference_type = ptrdiff_t;
+    using pointer = const value_t *;
+    using reference = value_t;
+
+    value_t operator*() const { return alg->read(j); }
+    iterator &operator++() {
+      j++;
+      return *this;
+    }
+    iterator operator++(int) {
+      iterator it(*this);
+      j++;
+      return it;
+    }
+    bool operator==(const iterator &rhs) const { return j == rhs.j; }
+    bool operator!=(const iterator &rhs) const { return j != rhs.j; }
+
+    lazyamsgrad *alg;
+    index_t j;
+  };
+
+  void step_parameters(const value_t gamma) { this->gamma = gamma; }
+  void boosting_parameters(const value_t mu, const value_t epsilon) {
+    this->mu = mu;
+    this->epsilon = epsilon;
+  }
+  void smoothing_parameters(const value_t beta, const value_t delta) {
+    this->beta = beta;
+    this->delta = delta;
+  }
+  void prox_parameters(const value_t lambda) { this->lambda = lambda; }
+
+  void initialize(const vector<value_t> &x0) {
+    const size_t d = x0.size();
+    x = x0;
+    nu.assign(d, 0);
+    v.assign(d, 0);
+    vhat.assign(d, 0);
+    g.assign(d, 0);
+    last.assign(d, 0);
+    stamp.assign(d, 0);
+    k = 0;
+  }
+
+  template <class Sampler, class Logger>
+  void solve(const csrview<value_t, index_t> &A, Sampler &sampler,
+             const index_t M, Logger &logger, const index_t K) {
+    vector<index_t> rows(M), touched;
+    vector<value_t> scales(M);
+    const index_t d = index_t(x.size());
+    for (index_t iter = 0; iter < K; iter++) {
+      k++;
+      sampler(begin(rows), end(rows));
+
+      /* bring the coordinates of the mini-batch up to iteration k - 1 */
+      touched.clear();
+      for (const auto row : rows)
+        for (index_t idx = A.rowptr[row]; idx < A.rowptr[row + 1]; idx++) {
+          const index_t j = A.colind[idx];
+          if (stamp[j] != k) {
+            stamp[j] = k;
+            catchup(j, k - 1);
+            touched.push_back(j);
+          }
+        }
+
+      double fval{0};
+      for (index_t m = 0; m < M; m++) {
+        const index_t row = rows[m];
+        value_t z{0};
+        for (index_t idx = A.rowptr[row]; idx < A.rowptr[row + 1]; idx++)
+          z += A.values[idx] * x[A.colind[idx]];
+        const value_t b = A.labels[row];
+        const value_t margin = -b * z;
+        const value_t e = exp(-abs(margin));
+        const value_t sigma = margin > 0 ? 1 / (1 + e) : e / (1 + e);
+        scales[m] = -b * sigma;
+        fval += margin > 0 ? margin + log1p(e) : log1p(e);
+      }
+      for (index_t m = 0; m < M; m++) {
+        const index_t row = rows[m];
+        for (index_t idx = A.rowptr[row]; idx < A.rowptr[row + 1]; idx++)
+          g[A.colind[idx]] += scales[m] * A.values[idx];
+      }
+
+      const value_t tau = gamma * lambda;
+      for (const auto j : touched) {
+        nu[j] = mu * nu[j] + epsilon * g[j];
+        v[j] = beta * v[j] + (1 - beta) * g[j] * g[j];
+        vhat[j] = max(vhat[j], v[j]);
+        const value_t y = x[j] - gamma * nu[j] / (sqrt(vhat[j]) + delta);
+        x[j] = y > tau ? y - tau : y < -tau ? y + tau : 0;
+        last[j] = k;
+      }
+
+      logger(k, value_t(fval), iterator{this, 0}, iterator{this, d}, &g[0]);
+      for (const auto j : touched)
+        g[j] = 0;
+    }
+  }
+
+  vector<value_t> getx() {
+    for (index_t j = 0; j < index_t(x.size()); j++)
+      catchup(j, k);
+    return x;
+  }
+
+private:
+  value_t read(const index_t j) {
+    catchup(j, k);
+    return x[j];
+  }
+
+  /* sum of mu^i for i = first, ..., last */
+  double geometric(const double first, const double last) const {
+    if (last < first)
+      return 0;
+    if (mu == 1)
+      return last - first + 1;
+    return (pow(double(mu), first) - pow(double(mu), last + 1)) / (1 - mu);
+  }
+
+  /* applies the iterations last[j] + 1, ..., to with zero gradient */
+  void catchup(const index_t j, const index_t to) {
+    const index_t s = to - last[j];
+    if (s <= 0)
+      return;
+    last[j] = to;
+
+    const double tau = double(gamma) * lambda;
+    const double c0 = double(gamma) * nu[j] / (sqrt(double(vhat[j])) + delta);
+    const double sign = c0 < 0 ? -1 : 1;
+    const double c = sign * c0;
+    double z = sign * x[j];
+    nu[j] *= pow(mu, value_t(s));
+    v[j] *= pow(beta, value_t(s));
+
+    /*
+     * With z mirrored so that the drift a_i = c * mu^i is non-negative, a
+     * positive z decreases by a_i + tau per iteration until it crosses zero.
+     */
+    index_t t{0};
+    if (z > 0) {
+      auto h = [&](const index_t n) {
+        return z - c * geometric(1, n) - n * tau;
+      };
+      index_t lo{0}, hi{s};
+      while (lo < hi) {
+        const index_t mid = lo + (hi - lo + 1) / 2;
+        if (h(mid) > 0)
+          lo = mid;
+        else
+          hi = mid - 1;
+      }
+      if (lo == s) {
+        x[j] = value_t(sign * h(s));
+        return;
+      }
+      t = lo + 1;
+      const double y = h(lo) - c * pow(double(mu), t);
+      z = y >= 0 ? 0 : min(y + tau, 0.);
+    }
+
+    /*
+     * A non-positive z moves by tau - a_i: away from zero while a_i > tau,
+     * i.e., up to iteration t1 - 1, and back towards zero, where it stays,
+     * afterwards.
+     */
+    index_t t1 = s + 1;
+    if (c <= tau)
+      t1 = 1;
+    else if (mu > 0 && mu < 1) {
+      const double estimate = ceil(log(tau / c) / log(double(mu)));
+      t1 = index_t(min(estimate, double(s + 1)));
+      while (t1 > 1 && c * pow(double(mu), t1 - 1) <= tau)
+        t1--;
+      while (t1 <= s && c * pow(double(mu), t1) > tau)
+        t1++;
+    } else if (mu == 0)
+      t1 = 1;
+    const index_t split = max(t + 1, t1);
+    z -= c * geometric(t + 1, split - 1) - (split - 1 - t) * tau;
+    z = min(z + (s - split + 1) * tau - c * geometric(split, s), 0.);
+    x[j] = value_t(sign * z);
+  }
+
+  value_t gamma{1}, mu{0}, epsilon{1}, beta{0}, delta{0}, lambda{0};
+  vector<value_t> x, nu, v, vhat, g;
+  vector<index_t> last, stamp;
+  index_t k{0};
+};
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef LOCKSTEP_HPP_
+#define LOCKSTEP_HPP_
+
+#include <condition_variable>
+#include <mutex>
+
+#include "instrument.hpp"
+#include "quadratic.hpp"
+
+/*
+ * Shares one quadratic among solvers running in separate threads. Each solver
+ * evaluates through its own participant; the calls are batched so that the
+ * last solver to arrive evaluates every waiting point in one pass over Q.
+ * A solver must leave() once it has finished so that the others do not wait
+ * for it. The batched evaluations and the solvers' waits for them are timed
+ * in the phases batch and wait, when given.
+ */
+template <class value_t, class index_t> struct lockstep {
+  struct participant {
+    value_t operator()(const value_t *x, value_t *g) const {
+      return parent->evaluate(id, x, g);
+    }
+
+    lockstep *parent;
+    index_t id;
+  };
+
+  lockstep(const quadratic<value_t, index_t> &qp, const index_t n,
+           phase *batch = nullptr, phase *wait = nullptr)
+      : qp(qp), batch{batch}, wait{wait}, active{n}, xs(n), gs(n), fs(n),
+        batchx(n), batchg(n), batchf(n) {}
+
+  participant operator[](const index_t id) noexcept {
+    return participant{this, id};
+  }
+
+  void leave() {
+    lock_guard<mutex> lock(mu);
+    active--;
+    if (waiting > 0 && waiting == active)
+      release();
+  }
+
+  size_t nbatches() const noexcept { return generation; }
+
+private:
+  value_t evaluate(const index_t id, const value_t *x, value_t *g) {
+    unique_lock<mutex> lock(mu);
+    xs[id] = x;
+    gs[id] = g;
+    const size_t current = generation;
+    if (++waiting == active)
+      release();
+    else {
+      const scope s(wait);
+      cv.wait(lock, [&]() { return generation != current; });
+    }
+    return value_t(fs[id]);
+  }
+
+  void release() {
+    index_t m{0};
+    for (size_t id = 0; id < xs.size(); id++)
+      if (xs[id] != nullptr) {
+        batchx[m] = xs[id];
+        batchg[m++] = gs[id];
+      }
+    {
+      const scope s(batch);
+      qp(m, batchx.data(), batchg.data(), batchf.data());
+    }
+    for (size_t id = 0, v = 0; id < xs.size(); id++)
+      if (xs[id] != nullptr) {
+        fs[id] = batchf[v++];
+        xs[id] = nullptr;
+      }
+    waiting = 0;
+    generation++;
+    cv.notify_all();
+  }
+
+  const quadratic<value_t, index_t> &qp;
+  phase *batch, *wait;
+  mutex mu;
+  condition_variable cv;
+  index_t active, waiting{0};
+  size_t generation{0};
+  vector<const value_t *> xs;
+  vector<value_t *> gs;
+  vector<double> fs;
+  vector<const value_t *> batchx;
+  vector<value_t *> batchg;
+  vector<double> batchf;
+};
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef MAPPEDFILE_HPP_
+#define MAPPEDFILE_HPP_
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct mappedfile {
+  mappedfile() = default;
+  mappedfile(const string &filename, const int advice = MADV_NORMAL) {
+    const int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+      throw runtime_error(filename + " could not be opened.");
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+      ::close(fd);
+      throw runtime_error(filename + " could not be queried.");
+    }
+    size_ = st.st_size;
+
+    if (size_ > 0) {
+      void *ptr = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+      if (ptr == MAP_FAILED) {
+        ::close(fd);
+        throw runtime_error(filename + " could not be memory-mapped.");
+      }
+      data_ = static_cast<const char *>(ptr);
+      ::madvise(ptr, size_, advice);
+    }
+    ::close(fd);
+  }
+
+  mappedfile(const mappedfile &) = delete;
+  mappedfile &operator=(const mappedfile &) = delete;
+
+  mappedfile(mappedfile &&other) noexcept
+      : data_{other.data_}, size_{other.size_} {
+    other.data_ = nullptr;
+    other.size_ = 0;
+  }
+  mappedfile &operator=(mappedfile &&other) noexcept {
+    if (this != &other) {
+      unmap();
+      data_ = other.data_;
+      size_ = other.size_;
+      other.data_ = nullptr;
+      other.size_ = 0;
+    }
+    return *this;
+  }
+
+  ~mappedfile() { unmap(); }
+
+  const char *data() const noexcept { return data_; }
+  size_t size() const noexcept { return size_; }
+
+private:
+  void unmap() noexcept {
+    if (data_ != nullptr)
+      ::munmap(const_cast<char *>(data_), size_);
+    data_ = nullptr;
+  }
+
+  const char *data_{nullptr};
+  size_t size_{0};
+};
+
+#endif
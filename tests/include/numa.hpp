@@ -0,0 +1,194 @@
+#ifndef NUMA_HPP_
+#define NUMA_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "csr.hpp"
+#include "csrlogistic.hpp"
+#include "parallel.hpp"
+
+/* Parses a sysfs CPU list such as "0-3,8-11" */
+inline vector<unsigned int> parsecpulist(const string &list) {
+  vector<unsigned int> cpus;
+  istringstream stream(list);
+  string range;
+  while (getline(stream, range, ',')) {
+    if (range.empty() || range == "\n")
+      continue;
+    const size_t dash = range.find('-');
+    const unsigned int first = stoul(range.substr(0, dash));
+    const unsigned int last =
+        dash == string::npos ? first : stoul(range.substr(dash + 1));
+    for (unsigned int cpu = first; cpu <= last; cpu++)
+      cpus.push_back(cpu);
+  }
+  return cpus;
+}
+
+/*
+ * Allowed CPUs grouped by NUMA node, as listed under
+ * /sys/devices/system/node. Nodes without allowed CPUs are dropped, and
+ * all allowed CPUs form one node when the topology is not available.
+ */
+inline vector<vector<unsigned int>> numanodes() {
+  const vector<unsigned int> allowed = allowedcpus();
+  vector<vector<unsigned int>> nodes;
+  for (unsigned int node = 0;; node++) {
+    ifstream file("/sys/devices/system/node/node" + to_string(node) +
+                  "/cpulist");
+    if (!file)
+      break;
+    string list;
+    getline(file, list);
+    vector<unsigned int> cpus;
+    for (const auto cpu : parsecpulist(list))
+      if (find(begin(allowed), end(allowed), cpu) != end(allowed))
+        cpus.push_back(cpu);
+    if (!cpus.empty())
+      nodes.push_back(move(cpus));
+  }
+  if (nodes.empty())
+    nodes.push_back(allowed);
+  return nodes;
+}
+
+/*
+ * Rows of a CSR matrix split into one contiguous, nnz-balanced part per NUMA
+ * node. Each part is copied by a thread pinned to its node, so that its pages
+ * are first touched, and hence allocated, there. Part p holds the rows
+ * first[p], ..., first[p + 1] - 1 of the matrix.
+ */
+template <class value_t, class index_t> struct numapartition {
+  numapartition() = default;
+  numapartition(const csrview<value_t, index_t> &A)
+      : nodes(numanodes()), parts(nodes.size()),
+        first(nodes.size() + 1, A.nrows) {
+    const size_t nnodes = nodes.size();
+    first[0] = 0;
+    for (size_t node = 1, row = 0; node < nnodes; node++) {
+      const int64_t target = int64_t(A.nnz()) * node / nnodes;
+      while (row < size_t(A.nrows) && A.rowptr[row] < target)
+        row++;
+      first[node] = index_t(row);
+    }
+
+    vector<thread> copiers(nnodes);
+    for (size_t node = 0; node < nnodes; node++)
+      copiers[node] = thread([&, node]() {
+        pin(nodes[node][0]);
+        const index_t begin = first[node], end = first[node + 1];
+        const index_t offset = A.rowptr[begin];
+        auto &part = parts[node];
+        part.nrows = end - begin;
+        part.ncols = A.ncols;
+        part.rowptr.resize(size_t(part.nrows) + 1);
+        for (index_t row = begin; row <= end; row++)
+          part.rowptr[row - begin] = A.rowptr[row] - offset;
+        part.colind.assign(A.colind + offset, A.colind + A.rowptr[end]);
+        part.values.assign(A.values + offset, A.values + A.rowptr[end]);
+        part.labels.assign(A.labels + begin, A.labels + end);
+      });
+    for (auto &copier : copiers)
+      copier.join();
+  }
+
+  vector<vector<unsigned int>> nodes;
+  vector<csrmatrix<value_t, index_t>> parts;
+  vector<index_t> first;
+};
+
+/*
+ * Logistic loss over a numapartition. The first mini-batch a solver thread
+ * evaluates pins it to a core, spreading the threads round-robin over the
+ * nodes. The sampled rows are looked up in the parts holding them, so the
+ * mini-batches, and hence the objective, are those of the whole matrix: a
+ * thread reads its local part for the part's share of the rows and the others
+ * remotely. Full evaluations sum over all the parts. The pinning outlives the
+ * run, so the caller restores the affinity of its own thread afterwards
+ * (affinityguard).
+ */
+template <class value_t, class index_t> struct numalogistic {
+  numalogistic(const numapartition<value_t, index_t> &partition)
+      : partition(&partition), state(make_shared<shared>()) {}
+
+  value_t operator()(const value_t *x, value_t *g) const {
+    const index_t d = partition->parts[0].ncols;
+    thread_local vector<value_t> gpart;
+    gpart.resize(d);
+    fill(g, g + d, value_t{0});
+    double fval{0};
+    for (const auto &part : partition->parts) {
+      fval += csrlogistic<value_t, index_t>(part.view())(x, &gpart[0]);
+      for (index_t idx = 0; idx < d; idx++)
+        g[idx] += gpart[idx];
+    }
+    return value_t(fval);
+  }
+
+  value_t operator()(const value_t *x, value_t *g, const index_t *ibegin,
+                     const index_t *iend) const {
+    thread_local struct {
+      uint64_t owner{0};
+      vector<vector<index_t>> rows;
+      vector<value_t> gpart;
+    } local;
+    const auto &parts = partition->parts;
+    const auto &first = partition->first;
+    if (local.owner != state->id) {
+      const auto &nodes = partition->nodes;
+      const size_t worker = state->next++;
+      local.owner = state->id;
+      const auto &cpus = nodes[worker % nodes.size()];
+      pin(cpus[(worker / nodes.size()) % cpus.size()]);
+    }
+    local.rows.resize(parts.size());
+    for (auto &rows : local.rows)
+      rows.clear();
+    for (const index_t *it = ibegin; it != iend; ++it) {
+      const size_t p =
+          size_t(upper_bound(begin(first), end(first), *it) - begin(first)) -
+          1;
+      local.rows[p].push_back(*it - first[p]);
+    }
+
+    const index_t d = parts[0].ncols;
+    local.gpart.resize(d);
+    fill(g, g + d, value_t{0});
+    double fval{0};
+    for (size_t p = 0; p < parts.size(); p++) {
+      const auto &rows = local.rows[p];
+      if (rows.empty())
+        continue;
+      fval += csrlogistic<value_t, index_t>(parts[p].view())(
+          x, &local.gpart[0], &rows[0], &rows[0] + rows.size());
+      for (index_t idx = 0; idx < d; idx++)
+        g[idx] += local.gpart[idx];
+    }
+    return value_t(fval);
+  }
+
+private:
+  struct shared {
+    shared() : id{++ids} {}
+
+    static atomic<uint64_t> ids;
+    const uint64_t id;
+    atomic<size_t> next{0};
+  };
+
+  const numapartition<value_t, index_t> *partition;
+  shared_ptr<shared> state;
+};
+
+template <class value_t, class index_t>
+atomic<uint64_t> numalogistic<value_t, index_t>::shared::ids{0};
+
+#endif
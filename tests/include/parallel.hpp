@@ -0,0 +1,124 @@
+#ifndef PARALLEL_HPP_
+#define PARALLEL_HPP_
+
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+
+/*
+ * Indices handed out to the threads of parallel_for. The first exception
+ * thrown by f stops handing them out and is rethrown by join().
+ */
+struct indexqueue {
+  indexqueue(const size_t n) : n{n} {}
+
+  template <class Function> void run(Function &f) {
+    size_t idx;
+    while ((idx = next++) < n)
+      try {
+        f(idx);
+      } catch (...) {
+        lock_guard<mutex> lock(mu);
+        if (!failure)
+          failure = current_exception();
+        next = n;
+      }
+  }
+
+  void join(vector<thread> &pool) {
+    for (auto &worker : pool)
+      worker.join();
+    if (failure)
+      rethrow_exception(failure);
+  }
+
+private:
+  const size_t n;
+  atomic<size_t> next{0};
+  mutex mu;
+  exception_ptr failure;
+};
+
+/* Runs f(0), ..., f(n - 1) on up to nthreads threads */
+template <class Function>
+void parallel_for(const size_t n, const unsigned int nthreads, Function f) {
+  indexqueue queue(n);
+  vector<thread> pool(min<size_t>(nthreads, n));
+  for (auto &worker : pool)
+    worker = thread([&]() { queue.run(f); });
+  queue.join(pool);
+}
+
+/* CPUs the process is allowed to run on */
+inline vector<unsigned int> allowedcpus() {
+  vector<unsigned int> cpus;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) == 0)
+    for (unsigned int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+      if (CPU_ISSET(cpu, &set))
+        cpus.push_back(cpu);
+  if (cpus.empty())
+    for (unsigned int cpu = 0; cpu < max(thread::hardware_concurrency(), 1u);
+         cpu++)
+      cpus.push_back(cpu);
+  return cpus;
+}
+
+/* Pins the calling thread to cpu */
+inline bool pin(const unsigned int cpu) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+/* Restricts the calling thread to cpus, leaving it as is when empty */
+inline bool pin(const vector<unsigned int> &cpus) {
+  if (cpus.empty())
+    return true;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (const auto cpu : cpus)
+    CPU_SET(cpu, &set);
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+/* Restores the CPU affinity of the calling thread when it goes out of scope */
+struct affinityguard {
+  affinityguard() {
+    CPU_ZERO(&set);
+    saved = pthread_getaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+  }
+  affinityguard(const affinityguard &) = delete;
+  affinityguard &operator=(const affinityguard &) = delete;
+  ~affinityguard() {
+    if (saved)
+      pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  }
+
+private:
+  cpu_set_t set;
+  bool saved;
+};
+
+/* Runs f(0), ..., f(n - 1) on one thread pinned to each of cpus */
+template <class Function>
+void parallel_for(const size_t n, const vector<unsigned int> &cpus,
+                  Function f) {
+  indexqueue queue(n);
+  vector<thread> pool(min<size_t>(cpus.size(), n));
+  for (size_t w = 0; w < pool.size(); w++)
+    pool[w] = thread([&, w]() {
+      pin(cpus[w]);
+      queue.run(f);
+    });
+  queue.join(pool);
+}
+
+#endif
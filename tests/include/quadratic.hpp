@@ -0,0 +1,279 @@
+#ifndef QUADRATIC_HPP_
+#define QUADRATIC_HPP_
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <sstream>
+
+#include "parallel.hpp"
+#include "rng.hpp"
+
+template <class value_t, class index_t> struct quadratic {
+  quadratic() = default;
+  quadratic(const index_t d, const value_t t, const uint64_t seed,
+            const unsigned int nthreads)
+      : d{d}, t{t}, seed{seed}, q(d), lambda(d) {
+    using lapack = utility::matrix::lapack<value_t>;
+    vector<value_t> D(size_t(d) * d), Q(size_t(d) * d), tau(d), work(1);
+    const index_t bs{64};
+    const size_t nblocks = (size_t(d) + bs - 1) / bs;
+
+    /* column col of the Gaussian matrix is stream col of the generator */
+    parallel_for(nblocks, nthreads, [&](const size_t block) {
+      const index_t first = index_t(block * bs);
+      const index_t last = min(d, index_t(first + bs));
+      for (index_t col = first; col < last; col++) {
+        const counterrng gen(seed, col);
+        value_t *column = &Q[size_t(col) * d];
+        for (index_t row = 0; row < d; row++)
+          column[row] = value_t(gen.normal(row));
+      }
+    });
+
+    const counterrng qgen(seed, ~uint64_t{0}), lgen(seed, ~uint64_t{1});
+    for (index_t idx = 0; idx < d; idx++) {
+      q[idx] = value_t(qgen.normal(idx));
+      lambda[idx] = pow(t, value_t(2 * lgen.uniform(idx) - 1));
+    }
+    lambda[0] = 1 / t;
+    lambda[d - 1] = t;
+
+    int info = lapack::geqrfp(d, d, &Q[0], d, &tau[0], &work[0], -1);
+    assert(info == 0);
+
+    int lwork = work[0];
+    work.resize(lwork);
+    info = lapack::geqrfp(d, d, &Q[0], d, &tau[0], &work[0], lwork);
+    assert(info == 0);
+
+    auto ormqr = [&](const char side, const char trans, const index_t n,
+                     value_t *C) {
+      int info = lapack::ormqr(side, trans, d, n, d, &Q[0], d, &tau[0], C, d,
+                               &work[0], -1);
+      assert(info == 0);
+      work.resize(max(work.size(), size_t(work[0])));
+      info = lapack::ormqr(side, trans, d, n, d, &Q[0], d, &tau[0], C, d,
+                           &work[0], int(work.size()));
+      assert(info == 0);
+    };
+
+    for (index_t i = 0; i < d; i++)
+      D[size_t(i) * d + i] = lambda[i];
+    ormqr('L', 'T', d, &D[0]);
+    ormqr('R', 'N', d, &D[0]);
+
+    this->Q = vector<value_t>((size_t(d) + 1) * d / 2);
+    parallel_for(d, nthreads, [&](const size_t col) {
+      const size_t offset = col * d - col * (col - 1) / 2;
+      copy(begin(D) + col * d + col, begin(D) + (col + 1) * d,
+           begin(this->Q) + offset);
+    });
+
+    /* Q = H^T diag(lambda) H, hence xopt = -H^T diag(lambda)^{-1} H q */
+    xopt_ = q;
+    ormqr('L', 'N', 1, &xopt_[0]);
+    for (index_t idx = 0; idx < d; idx++)
+      xopt_[idx] /= -lambda[idx];
+    ormqr('L', 'T', 1, &xopt_[0]);
+  }
+
+  /*
+   * Single pass over the packed lower triangle: column j contributes its dot
+   * product with x to (Qx)_j and its axpy with x_j to (Qx)_i, i > j. (Qx)_j is
+   * final once column j is done, so g accumulates Qx in place and the
+   * gradient and the objective are completed panel by panel. Panels of
+   * `width` columns share one load and store of g per row.
+   */
+  value_t operator()(const value_t *x, value_t *g) const {
+    double fval;
+    (*this)(1, &x, &g, &fval);
+    return value_t(fval);
+  }
+
+  /*
+   * Evaluates m points in one pass over Q. Each panel is streamed from memory
+   * for the first point and reused from cache for the others.
+   */
+  void operator()(const index_t m, const value_t *const *x, value_t *const *g,
+                  double *f) const {
+    for (index_t v = 0; v < m; v++) {
+      fill(g[v], g[v] + d, value_t{0});
+      f[v] = 0;
+    }
+    const value_t *column = Q.data(), *next = column;
+    value_t dot[width];
+    for (index_t j = 0; j < d;) {
+      const index_t w = d - j >= width ? width : 1;
+      for (index_t v = 0; v < m; v++) {
+        next = w == width ? panel<width>(j, column, x[v], g[v], dot)
+                          : panel<1>(j, column, x[v], g[v], dot);
+        for (index_t k = 0; k < w; k++) {
+          const value_t Qxj = g[v][j + k] + dot[k];
+          g[v][j + k] = Qxj + q[j + k];
+          f[v] += x[v][j + k] * (0.5 * Qxj + q[j + k]);
+        }
+      }
+      column = next;
+      j += w;
+    }
+  }
+
+  /* eigenvalues of Q in descending order */
+  vector<value_t> eigenvalues() const {
+    vector<value_t> D(lambda);
+    sort(begin(D), end(D), greater<value_t>());
+    return D;
+  }
+
+  vector<value_t> xopt() const noexcept { return xopt_; }
+
+  static string cachefile(const string &directory, const index_t d,
+                          const value_t t, const uint64_t seed) {
+    ostringstream name;
+    name << directory << "/qp-" << d << '-' << t << '-' << seed << ".bin";
+    return name.str();
+  }
+
+  void save(const string &filename) const {
+    ofstream file(filename, ios_base::binary);
+    if (!file)
+      throw runtime_error(filename + " could not be opened.");
+    auto put = [&](const void *data, const size_t bytes) {
+      file.write(static_cast<const char *>(data), bytes);
+    };
+    put(magic, 8);
+    put(&version, sizeof(version));
+    put(&d, sizeof(d));
+    put(&t, sizeof(t));
+    put(&seed, sizeof(seed));
+    put(Q.data(), Q.size() * sizeof(value_t));
+    put(q.data(), q.size() * sizeof(value_t));
+    put(lambda.data(), lambda.size() * sizeof(value_t));
+    put(xopt_.data(), xopt_.size() * sizeof(value_t));
+    if (!file)
+      throw runtime_error(filename + " could not be written.");
+  }
+
+  void load(const string &filename, const index_t d, const value_t t,
+            const uint64_t seed) {
+    ifstream file(filename, ios_base::binary);
+    if (!file)
+      throw runtime_error(filename + " could not be opened.");
+    auto get = [&](void *data, const size_t bytes) {
+      file.read(static_cast<char *>(data), bytes);
+    };
+    char buffer[8];
+    uint32_t fversion;
+    get(buffer, 8);
+    get(&fversion, sizeof(fversion));
+    get(&this->d, sizeof(this->d));
+    get(&this->t, sizeof(this->t));
+    get(&this->seed, sizeof(this->seed));
+    if (!file || memcmp(buffer, magic, 8) != 0 || fversion != version)
+      throw runtime_error(filename + " is not a supported QP file.");
+    if (this->d != d || this->t != t || this->seed != seed)
+      throw runtime_error(filename + " holds a different problem.");
+    Q.resize((size_t(d) + 1) * d / 2);
+    q.resize(d);
+    lambda.resize(d);
+    xopt_.resize(d);
+    get(Q.data(), Q.size() * sizeof(value_t));
+    get(q.data(), q.size() * sizeof(value_t));
+    get(lambda.data(), lambda.size() * sizeof(value_t));
+    get(xopt_.data(), xopt_.size() * sizeof(value_t));
+    if (!file)
+      throw runtime_error(filename + " is truncated.");
+  }
+
+  template <class T1, class T2>
+  friend ostream &operator<<(ostream &, const quadratic<T1, T2> &);
+
+private:
+  /* Accumulates columns j, ..., j + w - 1 into g and their dot products into
+   * dot, and returns the start of column j + w */
+  template <index_t w>
+  const value_t *panel(const index_t j, const value_t *column, const value_t *x,
+                       value_t *g, value_t *dot) const {
+    const value_t *a[w];
+    value_t xk[w];
+    for (index_t k = 0; k < w; k++) {
+      a[k] = column;
+      column += d - j - k;
+      xk[k] = x[j + k];
+      dot[k] = a[k][0] * xk[k];
+      for (index_t r = k + 1; r < w; r++) {
+        dot[k] += a[k][r - k] * x[j + r];
+        g[j + r] += a[k][r - k] * xk[k];
+      }
+      a[k] += w - k;
+    }
+
+    const index_t n = d - j - w;
+    const value_t *xs = x + j + w;
+    value_t *gs = g + j + w;
+    value_t acc[w][lanes] = {};
+    index_t i{0};
+    for (; i + lanes <= n; i += lanes)
+      for (index_t l = 0; l < lanes; l++) {
+        value_t sum{0};
+        for (index_t k = 0; k < w; k++) {
+          acc[k][l] += a[k][i + l] * xs[i + l];
+          sum += a[k][i + l] * xk[k];
+        }
+        gs[i + l] += sum;
+      }
+    for (; i < n; i++) {
+      value_t sum{0};
+      for (index_t k = 0; k < w; k++) {
+        dot[k] += a[k][i] * xs[i];
+        sum += a[k][i] * xk[k];
+      }
+      gs[i] += sum;
+    }
+    for (index_t k = 0; k < w; k++)
+      for (index_t l = 0; l < lanes; l++)
+        dot[k] += acc[k][l];
+    return column;
+  }
+
+  static constexpr index_t width{8}, lanes{8};
+  static constexpr char magic[8] = {'P', 'O', 'L', 'O', 'Q', 'P', '\0', '\0'};
+  static constexpr uint32_t version = 1;
+
+  index_t d{0};
+  value_t t{1};
+  uint64_t seed{0};
+  vector<value_t> Q, q, lambda, xopt_;
+};
+
+template <class value_t, class index_t>
+constexpr char quadratic<value_t, index_t>::magic[8];
+template <class value_t, class index_t>
+constexpr uint32_t quadratic<value_t, index_t>::version;
+template <class value_t, class index_t>
+constexpr index_t quadratic<value_t, index_t>::width;
+template <class value_t, class index_t>
+constexpr index_t quadratic<value_t, index_t>::lanes;
+
+template <class value_t, class index_t>
+ostream &operator<<(ostream &os, const quadratic<value_t, index_t> &qp) {
+  const size_t d = qp.d;
+  size_t idx{0};
+  for (size_t row = 0; row < d; row++) {
+    for (size_t col = 0; col < d; col++)
+      if (col > row)
+        os << setw(10) << setprecision(6) << '.' << '\t';
+      else
+        os << setw(10) << setprecision(6) << qp.Q[idx++] << '\t';
+    os << "\t\t" << setw(10) << setprecision(6) << qp.q[row] << '\n';
+  }
+  return os;
+}
+
+#endif
@@ -0,0 +1,173 @@
+#ifndef REGISTRY_HPP_
+#define REGISTRY_HPP_
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+
+#include <sys/stat.h>
+
+#include "csrfile.hpp"
+#include "mappedfile.hpp"
+
+inline uint64_t checksum(const char *data, const size_t size) {
+  uint64_t hash{0xcbf29ce484222325ULL};
+  const uint64_t prime{0x100000001b3ULL};
+  size_t idx{0};
+  for (; idx + 8 <= size; idx += 8) {
+    uint64_t word;
+    memcpy(&word, data + idx, 8);
+    hash = (hash ^ word) * prime;
+  }
+  for (; idx < size; idx++)
+    hash = (hash ^ uint8_t(data[idx])) * prime;
+  return hash;
+}
+
+inline uint64_t checksum(const string &filename) {
+  const mappedfile file(filename, MADV_SEQUENTIAL);
+  return checksum(file.data(), file.size());
+}
+
+struct shardfile {
+  int fid;
+  string format, path;
+  uint64_t bytes, checksum;
+  int64_t nsamples, nfeatures, nnz;
+
+  double density() const {
+    return nsamples > 0 && nfeatures > 0
+               ? double(nnz) / (double(nsamples) * nfeatures)
+               : 0;
+  }
+};
+
+/*
+ * Datasets are listed in data/datasets.lst as `name dense [nsamples
+ * nfeatures]`. The pieces of a dataset are described, one file per line, in
+ * data/<name>.manifest, which is read only when a piece is first resolved.
+ */
+template <class value_t, class index_t> struct registry {
+  struct entry {
+    string name;
+    bool dense;
+    index_t nsamples, nfeatures;
+  };
+
+  registry(const string &listfile = "data/datasets.lst")
+      : directory{listfile.substr(0, listfile.find_last_of('/') + 1)} {
+    ifstream dslist(listfile);
+    if (!dslist)
+      throw runtime_error(listfile + " could not be opened.");
+    string line;
+    while (getline(dslist, line)) {
+      istringstream ss(line);
+      entry e{"", false, 0, 0};
+      if (!(ss >> e.name >> boolalpha >> e.dense))
+        continue;
+      ss >> e.nsamples >> e.nfeatures;
+      entries.push_back(e);
+    }
+    manifests = vector<unique_ptr<vector<shardfile>>>(entries.size());
+    mutexes = vector<unique_ptr<mutex>>(entries.size());
+    for (auto &m : mutexes)
+      m.reset(new mutex);
+  }
+
+  size_t size() const noexcept { return entries.size(); }
+  const entry &operator[](const size_t id) const { return entries.at(id); }
+
+  void print(ostream &os) const {
+    for (size_t idx = 0; idx < entries.size(); idx++)
+      os << "  - " << idx << ") " << entries[idx].name << "("
+         << (entries[idx].dense ? "dense" : "sparse") << ")\n";
+  }
+
+  string path(const size_t id, const index_t fid,
+              const string &extension = "") const {
+    return directory + (*this)[id].name + "-" + to_string(fid) + extension;
+  }
+
+  const vector<shardfile> &manifest(const size_t id) const {
+    if (id >= entries.size())
+      throw out_of_range("dataset id " + to_string(id) + " is not registered");
+    lock_guard<mutex> lock(*mutexes[id]);
+    if (!manifests[id]) {
+      unique_ptr<vector<shardfile>> files(new vector<shardfile>);
+      ifstream file(directory + entries[id].name + ".manifest");
+      string line;
+      while (getline(file, line)) {
+        if (line.empty() || line[0] == '#')
+          continue;
+        istringstream ss(line);
+        shardfile s;
+        if (ss >> s.fid >> s.format >> s.path >> s.bytes >> hex >> s.checksum >>
+            dec >> s.nsamples >> s.nfeatures >> s.nnz)
+          files->push_back(s);
+      }
+      manifests[id] = move(files);
+    }
+    return *manifests[id];
+  }
+
+  const shardfile *find(const size_t id, const index_t fid,
+                        const string &format) const {
+    for (const auto &s : manifest(id))
+      if (s.fid == fid && s.format == format)
+        return &s;
+    return nullptr;
+  }
+
+  loss::data<value_t, index_t> load(const size_t id, const index_t fid,
+                                    const bool verify = false) const {
+    const string filename = resolve(id, fid, "bin", verify);
+    loss::data<value_t, index_t> dataset;
+    dataset.load(filename, (*this)[id].dense);
+    return dataset;
+  }
+
+  mappedcsr<value_t, index_t> map(const size_t id, const index_t fid,
+                                  const bool verify = false) const {
+    return mappedcsr<value_t, index_t>(resolve(id, fid, "csr", verify));
+  }
+
+  static void write(const string &filename, const vector<shardfile> &files) {
+    ofstream file(filename);
+    if (!file)
+      throw runtime_error(filename + " could not be opened.");
+    file << "# fid format path bytes checksum nsamples nfeatures nnz\n";
+    for (const auto &s : files)
+      file << s.fid << ' ' << s.format << ' ' << s.path << ' ' << s.bytes
+           << ' ' << hex << s.checksum << dec << ' ' << s.nsamples << ' '
+           << s.nfeatures << ' ' << s.nnz << '\n';
+    if (!file)
+      throw runtime_error(filename + " could not be written.");
+  }
+
+private:
+  string resolve(const size_t id, const index_t fid, const string &format,
+                 const bool verify) const {
+    const shardfile *s = find(id, fid, format);
+    if (s == nullptr)
+      return path(id, fid, "." + format);
+
+    struct stat st;
+    if (::stat(s->path.c_str(), &st) != 0)
+      throw runtime_error(s->path + " could not be found.");
+    if (uint64_t(st.st_size) != s->bytes)
+      throw runtime_error(s->path + " does not match its manifest size.");
+    if (verify && checksum(s->path) != s->checksum)
+      throw runtime_error(s->path + " does not match its manifest checksum.");
+    return s->path;
+  }
+
+  string directory;
+  vector<entry> entries;
+  mutable vector<unique_ptr<vector<shardfile>>> manifests;
+  vector<unique_ptr<mutex>> mutexes;
+};
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef RNG_HPP_
+#define RNG_HPP_
+
+#include <cmath>
+#include <cstdint>
+
+/*
+ * Counter-based generator: the n-th number of a stream is a pure function of
+ * (seed, stream, n), so blocks of a sequence can be generated in any order and
+ * on any number of threads with identical results.
+ */
+struct counterrng {
+  counterrng(const uint64_t seed, const uint64_t stream)
+      : key{mix(mix(seed) ^ (stream * 0xd1b54a32d192ed03ULL))} {}
+
+  uint64_t operator()(const uint64_t counter) const noexcept {
+    return mix(key + counter * 0x9e3779b97f4a7c15ULL);
+  }
+
+  /* uniform in [0, 1) */
+  double uniform(const uint64_t counter) const noexcept {
+    return ((*this)(counter) >> 11) * (1.0 / 9007199254740992.0);
+  }
+
+  /* uniform in {0, ..., n - 1} for n < 2^32, by a multiply-shift */
+  uint64_t below(const uint64_t counter, const uint64_t n) const noexcept {
+    return (((*this)(counter) >> 32) * n) >> 32;
+  }
+
+  /*
+   * out[0], ..., out[m - 1] uniform in {0, ..., n - 1} from the counters
+   * counter, ..., counter + m - 1 of a keyed 32-bit mixer (lowbias32 of C.
+   * Wellons with its second round shortened). The iterations need no 64-bit
+   * multiplies, so they vectorize; the lanes pay off with AVX2, while SSE2,
+   * lacking 32-bit multiplies, about matches the scalar loop. These are not
+   * the numbers below(counter, n) returns.
+   */
+  template <class T>
+  void below(const uint64_t counter, const uint32_t n, T *out,
+             const size_t m) const noexcept {
+    const uint32_t k0 = uint32_t(key), k1 = uint32_t(key >> 32);
+    for (size_t idx = 0; idx < m; idx++) {
+      const uint64_t c = counter + idx;
+      uint32_t x = mix32(uint32_t(c) ^ k0) ^ uint32_t(c >> 32) ^ k1;
+      x = (x ^ (x >> 15)) * 0x846ca68bu;
+      x ^= x >> 16;
+      out[idx] = T((uint64_t(x) * n) >> 32);
+    }
+  }
+
+  /* standard normal, by Box-Muller on the counters 2n and 2n + 1 */
+  double normal(const uint64_t counter) const noexcept {
+    const double u1 = 1 - uniform(2 * counter);
+    const double u2 = uniform(2 * counter + 1);
+    return sqrt(-2 * log(u1)) * cos(6.283185307179586 * u2);
+  }
+
+private:
+  /* lowbias32 */
+  static uint32_t mix32(uint32_t x) noexcept {
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    return x ^ (x >> 16);
+  }
+
+  static uint64_t mix(uint64_t z) noexcept {
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+  }
+
+  uint64_t key;
+};
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef SCALING_HPP_
+#define SCALING_HPP_
+
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "iterlog.hpp"
+
+/* Wall-clock time and objective trace of one run with W threads */
+template <class value_t, class index_t> struct scalingrun {
+  index_t W, K;
+  double seconds;
+  vector<value_t> t, f; /* t in ms, as logged */
+
+  value_t best() const {
+    value_t fbest = numeric_limits<value_t>::infinity();
+    for (const auto fval : f)
+      fbest = min(fbest, fval);
+    return fbest;
+  }
+
+  /* seconds until the objective first drops to target, or NaN */
+  double timeto(const value_t target) const {
+    for (size_t n = 0; n < f.size(); n++)
+      if (f[n] <= target)
+        return t[n] / 1000.;
+    return numeric_limits<double>::quiet_NaN();
+  }
+};
+
+/* Evaluates the l1-regularized objective at the iterates of a log */
+template <class value_t, class index_t, class Loss>
+void evaluatelog(const string &filename, const Loss &loss,
+                 scalingrun<value_t, index_t> &run) {
+  const logreader<value_t, index_t> reader(filename);
+  const index_t d = reader.dimension();
+  const value_t lambda1 = reader.lambda1();
+  vector<value_t> x(d), g(d);
+  run.t.resize(reader.size());
+  run.f.resize(reader.size());
+  for (index_t n = 0; n < reader.size(); n++) {
+    reader.read(n, &x[0], n - 1);
+    value_t l1{0};
+    for (const auto val : x)
+      l1 += abs(val);
+    run.t[n] = reader.gett(n);
+    run.f[n] = loss(&x[0], &g[0]) + lambda1 * l1;
+  }
+}
+
+/*
+ * Writes throughput, time to target and the speedup and efficiency relative
+ * to the run with the fewest threads. Unless given, the target is the best
+ * objective that every run reaches.
+ */
+template <class value_t, class index_t>
+void savescaling(const string &filename,
+                 const vector<scalingrun<value_t, index_t>> &runs,
+                 value_t target = numeric_limits<value_t>::quiet_NaN()) {
+  if (runs.empty())
+    return;
+  if (std::isnan(target)) {
+    target = -numeric_limits<value_t>::infinity();
+    for (const auto &run : runs)
+      target = max(target, run.best());
+  }
+  const scalingrun<value_t, index_t> *base = &runs[0];
+  for (const auto &run : runs)
+    if (run.W < base->W)
+      base = &run;
+  const double tbase = base->timeto(target);
+
+  ofstream file(filename);
+  if (!file)
+    throw runtime_error(filename + " could not be opened.");
+  file << "W,seconds,iterations-per-sec,target,time-to-target,speedup,"
+          "efficiency\n";
+  for (const auto &run : runs) {
+    const double ttarget = run.timeto(target);
+    const double speedup = tbase / ttarget;
+    file << run.W << ',' << run.seconds << ',' << run.K / run.seconds << ','
+         << target << ',' << ttarget << ',' << speedup << ','
+         << speedup * base->W / run.W << '\n';
+  }
+  if (!file)
+    throw runtime_error(filename + " could not be written.");
+}
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef SHARDPLAN_HPP_
+#define SHARDPLAN_HPP_
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "csr.hpp"
+#include "csrfile.hpp"
+#include "dsstats.hpp"
+#include "mappedfile.hpp"
+#include "registry.hpp"
+
+/*
+ * Assignment of rows to the shards 1, ..., W with balanced nonzeros. Rows are
+ * taken in order and each goes to the shard with the fewest nonzeros so far
+ * (the lowest one on ties), which keeps the interleaving of a round-robin
+ * split while bounding the imbalance by the longest row.
+ */
+struct shardplan {
+  shardplan() = default;
+  template <class InputIt>
+  shardplan(InputIt first, InputIt last, const int W)
+      : nnz(W), nrows(W) {
+    using load = pair<int64_t, int>;
+    priority_queue<load, vector<load>, greater<load>> heap;
+    for (int s = 0; s < W; s++)
+      heap.emplace(0, s);
+    for (InputIt it = first; it != last; ++it) {
+      const int s = heap.top().second;
+      heap.pop();
+      shards.push_back(s + 1);
+      nnz[s] += *it;
+      nrows[s]++;
+      heap.emplace(nnz[s], s);
+    }
+  }
+
+  int nshards() const noexcept { return int(nnz.size()); }
+
+  /* largest over average nonzeros of the shards */
+  double imbalance() const {
+    int64_t total{0}, largest{0};
+    for (const auto val : nnz) {
+      total += val;
+      largest = max(largest, val);
+    }
+    return total > 0 ? double(largest) * nnz.size() / total : 1;
+  }
+
+  vector<int> shards;         /* of the rows */
+  vector<int64_t> nnz, nrows; /* of the shards */
+};
+
+template <class value_t, class index_t>
+shardplan planshards(const csrview<value_t, index_t> &A, const int W) {
+  vector<index_t> rownnz(A.nrows);
+  for (index_t row = 0; row < A.nrows; row++)
+    rownnz[row] = A.rowptr[row + 1] - A.rowptr[row];
+  return shardplan(begin(rownnz), end(rownnz), W);
+}
+
+/*
+ * Writes the rows of shard s as <prefix>-<s>.{bin,csr,stats}, as csv-splitter
+ * does, and returns their manifest entries.
+ */
+template <class value_t, class index_t>
+vector<shardfile> saveshard(const csrview<value_t, index_t> &A,
+                            const shardplan &plan, const int s,
+                            const string &prefix,
+                            dsstats<value_t, index_t> &stats) {
+  csrmatrix<value_t, index_t> shard;
+  shard.ncols = A.ncols;
+  shard.rowptr.push_back(0);
+  for (index_t row = 0; row < A.nrows; row++) {
+    if (plan.shards[row] != s)
+      continue;
+    shard.colind.insert(end(shard.colind), A.colind + A.rowptr[row],
+                        A.colind + A.rowptr[row + 1]);
+    shard.values.insert(end(shard.values), A.values + A.rowptr[row],
+                        A.values + A.rowptr[row + 1]);
+    shard.labels.push_back(A.labels[row]);
+    shard.rowptr.push_back(index_t(shard.values.size()));
+  }
+  shard.nrows = index_t(shard.labels.size());
+
+  stats = dsstats<value_t, index_t>(shard.view());
+  const string outfile = prefix + "-" + to_string(s);
+  stats.save(outfile + ".stats");
+  csrfile::save(shard.view(), outfile + ".csr");
+  move(shard).todata().save(outfile + ".bin");
+
+  vector<shardfile> files;
+  for (const string format : {"bin", "csr"}) {
+    const mappedfile file(outfile + "." + format, MADV_SEQUENTIAL);
+    files.push_back(shardfile{s, format, outfile + "." + format, file.size(),
+                              checksum(file.data(), file.size()),
+                              stats.nsamples, stats.nfeatures, stats.nnz});
+  }
+  return files;
+}
+
+#endif
@@ -0,0 +1,123 @@
+#ifndef STREAMLOGGER_HPP_
+#define STREAMLOGGER_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "iterlog.hpp"
+#include "parallel.hpp"
+
+/*
+ * Logs every 100th iterate like customlogger, but hands the states over to a
+ * background writer through a bounded ring instead of keeping them in memory
+ * until the solver returns. The solver only waits when the writer falls
+ * `capacity` states behind. The threads of the (in)consistent executors may
+ * log concurrently, so producers claim, fill and publish their slots one at a
+ * time under a mutex; the writer is the single consumer. The writer runs on
+ * `cpus` when given, and otherwise inherits the affinity of the constructing
+ * thread.
+ */
+template <class value_t, class index_t> struct streamlogger {
+  streamlogger(const string &filename, const value_t lambda1, const index_t d,
+               const bool delta = false, const size_t capacity = 16,
+               const vector<unsigned int> &cpus = {})
+      : writer(filename, lambda1, d, delta), slots(capacity),
+        tstart{chrono::steady_clock::now()} {
+    for (auto &slot : slots)
+      slot.x.resize(d);
+    consumer = thread([this, cpus]() {
+      pin(cpus);
+      drain();
+    });
+  }
+
+  streamlogger(const streamlogger &) = delete;
+  streamlogger &operator=(const streamlogger &) = delete;
+
+  ~streamlogger() {
+    try {
+      close();
+    } catch (...) {
+    }
+  }
+
+  template <class InputIt1, class InputIt2>
+  void operator()(const index_t k, const value_t, InputIt1 xbegin,
+                  InputIt1 xend, InputIt2) {
+    if ((k == 1) | (k % 100 == 0)) {
+      lock_guard<mutex> lock(producers);
+      cout << "Logging at iteration k = " << k << ".\n";
+      const size_t pos = tail.load(memory_order_relaxed);
+      if (pos - head.load(memory_order_acquire) == slots.size()) {
+        stalls++;
+        while (pos - head.load(memory_order_acquire) == slots.size())
+          this_thread::yield();
+      }
+      auto &slot = slots[pos % slots.size()];
+      slot.k = k;
+      slot.t = chrono::duration<value_t, milli>(chrono::steady_clock::now() -
+                                                tstart)
+                   .count();
+      copy(xbegin, xend, begin(slot.x));
+      tail.store(pos + 1, memory_order_release);
+    }
+  }
+
+  void close() {
+    if (!consumer.joinable())
+      return;
+    done.store(true, memory_order_release);
+    consumer.join();
+    writer.close();
+    if (failure)
+      rethrow_exception(failure);
+  }
+
+  index_t size() const noexcept { return writer.size(); }
+  int64_t bytes() const noexcept { return writer.bytes(); }
+  size_t nstalls() const noexcept { return stalls; }
+
+private:
+  struct slot_t {
+    index_t k;
+    value_t t;
+    vector<value_t> x;
+  };
+
+  void drain() {
+    size_t pos = head.load(memory_order_relaxed);
+    while (true) {
+      if (pos == tail.load(memory_order_acquire)) {
+        if (done.load(memory_order_acquire) &&
+            pos == tail.load(memory_order_acquire))
+          break;
+        this_thread::sleep_for(chrono::microseconds(100));
+        continue;
+      }
+      const auto &slot = slots[pos % slots.size()];
+      if (!failure) {
+        try {
+          writer.write(slot.k, slot.t, begin(slot.x));
+        } catch (...) {
+          failure = current_exception();
+        }
+      }
+      head.store(++pos, memory_order_release);
+    }
+  }
+
+  logwriter<value_t, index_t> writer;
+  vector<slot_t> slots;
+  chrono::steady_clock::time_point tstart;
+  atomic<size_t> head{0}, tail{0};
+  atomic<bool> done{false};
+  mutex producers;
+  size_t stalls{0};
+  exception_ptr failure;
+  thread consumer;
+};
+
+#endif
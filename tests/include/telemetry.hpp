@@ -0,0 +1,257 @@
+#ifndef TELEMETRY_HPP_
+#define TELEMETRY_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "iterlog.hpp"
+
+/*
+ * Log-linear histogram of nonnegative integers (cf. HdrHistogram): values
+ * below 2^subbits have their own buckets, and every further power of two is
+ * split into 2^subbits buckets, so quantiles are within 2^-subbits of the
+ * recorded values.
+ */
+struct hdrhistogram {
+  static constexpr int subbits = 5;
+  static constexpr uint64_t subbuckets = uint64_t{1} << subbits;
+
+  void record(const uint64_t val) {
+    const size_t idx = bucket(val);
+    if (idx >= counts.size())
+      counts.resize(idx + 1);
+    counts[idx]++;
+    total++;
+    sum += double(val);
+    smallest = std::min(smallest, val);
+    largest = std::max(largest, val);
+  }
+
+  uint64_t count() const noexcept { return total; }
+  uint64_t min() const noexcept { return total > 0 ? smallest : 0; }
+  uint64_t max() const noexcept { return largest; }
+  double mean() const noexcept { return total > 0 ? sum / total : 0; }
+
+  /* the largest value of the bucket holding the q-quantile */
+  uint64_t quantile(const double q) const {
+    const uint64_t rank = uint64_t(q * (total > 0 ? total - 1 : 0));
+    uint64_t seen{0};
+    for (size_t idx = 0; idx < counts.size(); idx++) {
+      seen += counts[idx];
+      if (seen > rank)
+        return std::min(largest, lowest(idx + 1) - 1);
+    }
+    return largest;
+  }
+
+  static size_t bucket(const uint64_t val) noexcept {
+    if (val < subbuckets)
+      return size_t(val);
+    const int e = 63 - __builtin_clzll(val);
+    return size_t((e - subbits + 1) * subbuckets +
+                  ((val >> (e - subbits)) - subbuckets));
+  }
+
+  static uint64_t lowest(const size_t idx) noexcept {
+    if (idx < subbuckets)
+      return idx;
+    const int e = int(idx / subbuckets) + subbits - 1;
+    return (subbuckets + idx % subbuckets) << (e - subbits);
+  }
+
+private:
+  vector<uint64_t> counts;
+  uint64_t total{0}, smallest{UINT64_MAX}, largest{0};
+  double sum{0};
+};
+
+constexpr char tracemagic[8] = {'P', 'O', 'L', 'O', 'T', 'R', 'C', '\0'};
+constexpr uint32_t traceversion = 1;
+
+/*
+ * Per-update telemetry of the parameter server's master: for each gradient
+ * received, the worker, the master's iteration, the staleness (the iteration
+ * minus the one of the iterate the worker read), the round trip from sending
+ * the iterate to receiving the gradient, and the worker's time in between.
+ * Updates go to a binary trace,
+ *
+ *   header : magic[8], version
+ *   records: worker, k, staleness, round trip [us], compute [us] (varints)
+ *
+ * and into histograms, overall and per worker, saved as CSV.
+ */
+struct telemetry {
+  telemetry(const string &tracefile)
+      : tracefile{tracefile}, file(tracefile, ios_base::binary) {
+    if (!file)
+      throw runtime_error(tracefile + " could not be opened.");
+    file.write(tracemagic, sizeof(tracemagic));
+    file.write(reinterpret_cast<const char *>(&traceversion),
+               sizeof(traceversion));
+  }
+
+  void record(const uint32_t worker, const uint64_t k,
+              const uint64_t staleness, const uint64_t roundtrip,
+              const uint64_t compute) {
+    lock_guard<mutex> lock(mu);
+    iterlog::putvarint(buffer, worker);
+    iterlog::putvarint(buffer, uint32_t(k));
+    iterlog::putvarint(buffer, uint32_t(staleness));
+    iterlog::putvarint(buffer, uint32_t(roundtrip));
+    iterlog::putvarint(buffer, uint32_t(compute));
+    if (buffer.size() >= (size_t{1} << 20))
+      flush();
+    for (auto *h : {&all, &workers[worker]}) {
+      h->staleness.record(staleness);
+      h->roundtrip.record(roundtrip);
+      h->compute.record(compute);
+    }
+  }
+
+  uint64_t nupdates() const {
+    lock_guard<mutex> lock(mu);
+    return all.staleness.count();
+  }
+
+  uint64_t roundtrip(const double q) const {
+    lock_guard<mutex> lock(mu);
+    return all.roundtrip.quantile(q);
+  }
+
+  uint64_t maxstaleness() const {
+    lock_guard<mutex> lock(mu);
+    return all.staleness.max();
+  }
+
+  void close() {
+    lock_guard<mutex> lock(mu);
+    flush();
+    file.close();
+    if (!file)
+      throw runtime_error(tracefile + " could not be written.");
+  }
+
+  void save(const string &filename) const {
+    ofstream csv(filename);
+    if (!csv)
+      throw runtime_error(filename + " could not be opened.");
+    csv << "worker,metric,count,mean,min,p50,p90,p99,p99.9,max\n";
+    auto put = [&](const string &worker, const string &metric,
+                   const hdrhistogram &h) {
+      csv << worker << ',' << metric << ',' << h.count() << ',' << h.mean()
+          << ',' << h.min() << ',' << h.quantile(0.5) << ','
+          << h.quantile(0.9) << ',' << h.quantile(0.99) << ','
+          << h.quantile(0.999) << ',' << h.max() << '\n';
+    };
+    lock_guard<mutex> lock(mu);
+    auto putall = [&](const string &worker, const histograms &h) {
+      put(worker, "staleness", h.staleness);
+      put(worker, "roundtrip-us", h.roundtrip);
+      put(worker, "compute-us", h.compute);
+    };
+    putall("all", all);
+    for (const auto &worker : workers)
+      putall(to_string(worker.first), worker.second);
+    if (!csv)
+      throw runtime_error(filename + " could not be written.");
+  }
+
+private:
+  struct histograms {
+    hdrhistogram staleness, roundtrip, compute;
+  };
+
+  void flush() {
+    file.write(buffer.data(), buffer.size());
+    buffer.clear();
+  }
+
+  string tracefile;
+  ofstream file;
+  string buffer;
+  histograms all;
+  map<uint32_t, histograms> workers;
+  mutable mutex mu;
+};
+
+inline uint64_t nowus() {
+  return uint64_t(chrono::duration_cast<chrono::microseconds>(
+                      chrono::steady_clock::now().time_since_epoch())
+                      .count());
+}
+
+/* State shared by the copies of a traced encoder */
+struct tracestate {
+  /* on the master */
+  tracestate(telemetry &recorder) : recorder{&recorder} {}
+  /* on a worker */
+  tracestate(const uint32_t worker) : worker{worker} {}
+
+  telemetry *recorder{nullptr};
+  uint32_t worker{0};
+  atomic<uint64_t> k{0}; /* gradients received by the master */
+  mutex mu;
+  uint64_t kread{0}, tsent{0}, treceived{0}; /* of the last iterate read */
+};
+
+/*
+ * An encoder that prefixes its messages with a header: the master's iterates
+ * carry its iteration and the time they were sent, which the workers return
+ * along with their ids and compute times in the headers of their gradients.
+ * The times are the master's, so no clocks need to be synchronized.
+ */
+template <class Encoder> struct traced {
+  traced(Encoder enc, shared_ptr<tracestate> state)
+      : enc(move(enc)), state(move(state)) {}
+
+  template <class InputIt> string encode(InputIt first, InputIt last) const {
+    string header;
+    if (state->recorder) {
+      iterlog::putvarint(header, uint32_t(state->k.load()));
+      iterlog::putraw(header, nowus());
+    } else {
+      lock_guard<mutex> lock(state->mu);
+      iterlog::putvarint(header, state->worker);
+      iterlog::putvarint(header, uint32_t(state->kread));
+      iterlog::putraw(header, state->tsent);
+      iterlog::putvarint(header, uint32_t(nowus() - state->treceived));
+    }
+    return header + enc.encode(first, last);
+  }
+
+  template <class OutputIt>
+  OutputIt decode(const string &message, OutputIt first) const {
+    const char *ptr = message.data();
+    if (state->recorder) {
+      const uint32_t worker = iterlog::getvarint(ptr);
+      const uint64_t kread = iterlog::getvarint(ptr);
+      const uint64_t tsent = iterlog::getraw<uint64_t>(ptr);
+      const uint64_t compute = iterlog::getvarint(ptr);
+      const uint64_t k = state->k++;
+      state->recorder->record(worker, k, k > kread ? k - kread : 0,
+                              nowus() - tsent, compute);
+    } else {
+      const uint64_t kread = iterlog::getvarint(ptr);
+      const uint64_t tsent = iterlog::getraw<uint64_t>(ptr);
+      lock_guard<mutex> lock(state->mu);
+      state->kread = kread;
+      state->tsent = tsent;
+      state->treceived = nowus();
+    }
+    return enc.decode(message.substr(ptr - message.data()), first);
+  }
+
+private:
+  Encoder enc;
+  shared_ptr<tracestate> state;
+};
+
+#endif
@@ -0,0 +1,140 @@
+#ifndef VARIANTS_HPP_
+#define VARIANTS_HPP_
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "batchsampler.hpp"
+#include "csr.hpp"
+#include "lazyamsgrad.hpp"
+
+/*
+ * Mini-batch variants of the logloss experiments, chosen at run time. The
+ * block variants also sample coordinate blocks, and the consistent and
+ * inconsistent ones update them on W threads sharing the decision vector.
+ * The lazy variant works on the CSR rows directly instead of the loss.
+ */
+const vector<string> mbvariants{"serial-mb",
+                                "serial-mb-adam",
+                                "serial-mb-amsgrad",
+                                "serial-mb-amsgrad-lazy",
+                                "serial-mb-adam-block",
+                                "consistent-mb-adam-block",
+                                "inconsistent-mb-adam-block"};
+
+inline bool ismbvariant(const string &variant) {
+  return find(begin(mbvariants), end(mbvariants), variant) != end(mbvariants);
+}
+
+inline bool isblock(const string &variant) {
+  return variant.size() > 6 &&
+         variant.compare(variant.size() - 6, 6, "-block") == 0;
+}
+
+inline bool isthreaded(const string &variant) {
+  return variant.compare(0, 11, "consistent-") == 0 ||
+         variant.compare(0, 13, "inconsistent-") == 0;
+}
+
+template <class value_t, class index_t> struct mbsettings {
+  index_t N, d;  /* samples and features */
+  index_t M, Md; /* mini-batch and coordinate block sizes */
+  index_t K, W;  /* iterations and threads */
+  value_t L;     /* Lipschitz constant of the mini-batch gradients */
+  value_t lambda1;
+  uint64_t seed; /* of the mini-batch and coordinate block samplers */
+};
+
+template <class value_t, class index_t>
+string mbsuffix(const string &variant, const mbsettings<value_t, index_t> &s) {
+  if (isthreaded(variant))
+    return variant + "-" + to_string(s.Md) + "-" + to_string(s.W);
+  else if (isblock(variant))
+    return variant + "-" + to_string(s.Md);
+  return variant + "-" + to_string(s.M);
+}
+
+template <class value_t, class index_t, class Algorithm, class Loss,
+          class Logger>
+void solvemb(Algorithm &alg, const bool block, const Loss &loss,
+             const csrview<value_t, index_t> &A, Logger &logger,
+             const mbsettings<value_t, index_t> &s,
+             const vector<value_t> &x0) {
+  alg.prox_parameters(s.lambda1);
+  alg.initialize(x0);
+  batchsampler<value_t, index_t> sampler(s.seed, 1, s.N,
+                                         A.nrows > 0 ? &A : nullptr);
+  if (block) {
+    batchsampler<value_t, index_t> blocksampler(s.seed, 2, s.d);
+    alg.solve(loss, utility::sampler::component, sampler, s.M,
+              utility::sampler::coordinate, blocksampler, s.Md, logger,
+              terminator::iteration<value_t, index_t>(s.K));
+  } else
+    alg.solve(loss, utility::sampler::component, sampler, s.M, logger,
+              terminator::iteration<value_t, index_t>(s.K));
+}
+
+template <class Algorithm> void adam(Algorithm &alg, const double B) {
+  alg.step_parameters(1. / B);
+  alg.boosting_parameters(0.9, 0.1);
+  alg.smoothing_parameters(0.999, 1E-8);
+}
+
+template <class value_t, class index_t, class Loss, class Logger>
+void solvemb(const string &variant, const Loss &loss,
+             const csrview<value_t, index_t> &A, Logger &logger,
+             const mbsettings<value_t, index_t> &s,
+             const vector<value_t> &x0) {
+  const index_t B = s.N / s.M;
+  const bool block = isblock(variant);
+  if (variant == "serial-mb") {
+    algorithm::proxgradient<value_t, index_t, boosting::none, step::constant,
+                            smoothing::none, prox::l1norm, execution::serial>
+        alg;
+    alg.step_parameters(1 / s.L / B);
+    solvemb(alg, block, loss, A, logger, s, x0);
+  } else if (variant == "serial-mb-adam" || variant == "serial-mb-adam-block") {
+    algorithm::proxgradient<value_t, index_t, boosting::momentum,
+                            step::constant, smoothing::rmsprop, prox::l1norm,
+                            execution::serial>
+        alg;
+    adam(alg, B);
+    solvemb(alg, block, loss, A, logger, s, x0);
+  } else if (variant == "serial-mb-amsgrad") {
+    algorithm::proxgradient<value_t, index_t, boosting::momentum,
+                            step::constant, smoothing::amsgrad, prox::l1norm,
+                            execution::serial>
+        alg;
+    adam(alg, B);
+    solvemb(alg, block, loss, A, logger, s, x0);
+  } else if (variant == "serial-mb-amsgrad-lazy") {
+    lazyamsgrad<value_t, index_t> alg;
+    adam(alg, B);
+    alg.prox_parameters(s.lambda1);
+    alg.initialize(x0);
+    batchsampler<value_t, index_t> sampler(s.seed, 1, s.N, &A);
+    alg.solve(A, sampler, s.M, logger, s.K);
+  } else if (variant == "consistent-mb-adam-block") {
+    algorithm::proxgradient<value_t, index_t, boosting::momentum,
+                            step::constant, smoothing::rmsprop, prox::l1norm,
+                            execution::consistent>
+        alg;
+    adam(alg, B);
+    alg.execution_parameters(s.W);
+    solvemb(alg, block, loss, A, logger, s, x0);
+  } else if (variant == "inconsistent-mb-adam-block") {
+    algorithm::proxgradient<value_t, index_t, boosting::momentum,
+                            step::constant, smoothing::rmsprop, prox::l1norm,
+                            execution::inconsistent>
+        alg;
+    adam(alg, B);
+    alg.execution_parameters(s.W);
+    solvemb(alg, block, loss, A, logger, s, x0);
+  } else
+    throw invalid_argument(variant + " is not a mini-batch variant.");
+}
+
+#endif
@@ -1,6 +1,11 @@
 #!/usr/bin/env bash
 
 id=1
+encoder=${1:-identity}
+nworkers=${2:-5}
+mport=${MASTER_PORT:-50000}
+sport=${SCHEDULER_PORT:-40000}
+ports="--master-port $mport --scheduler-port $sport"
 
 for agent in master worker scheduler; do
   if [ ! -f "logloss-ps-piag-${agent}" ]; then
@@ -9,13 +14,22 @@ for agent in master worker scheduler; do
   fi
 done
 
-./logloss-ps-piag-scheduler -d 0 -s "*" 1>scheduler.log 2>scheduler.err &
+args=()
+for arg in "${@:3}"; do
+  if [ "$arg" == "--split" ]; then
+    ./csv-splitter -i data/rcv1-0 -o data/rcv1 -n $nworkers -b -w -B || exit -1
+  else
+    args+=("$arg")
+  fi
+done
+
+./logloss-ps-piag-scheduler -d 0 -s "*" $ports 1>scheduler.log 2>scheduler.err &
 pids[$(( id++))]=$!
-./logloss-ps-piag-master -d 0 -l 1E-4 -m 127.0.0.1 -s 127.0.0.1 1>master.log 2>master.err &
+./logloss-ps-piag-master -d 0 -l 1E-4 -f 0 -W $nworkers -m 127.0.0.1 -s 127.0.0.1 $ports -D -e $encoder "${args[@]}" 1>master.log 2>master.err &
 pids[$(( id++))]=$!
 
-for num in $(seq 5); do
-  ./logloss-ps-piag-worker -d 0 -f $num -s 127.0.0.1 1>worker-$num.log 2>worker-$num.err &
+for num in $(seq $nworkers); do
+  ./logloss-ps-piag-worker -d 0 -f $num -s 127.0.0.1 $ports --mmap -e $encoder "${args[@]}" 1>worker-$num.log 2>worker-$num.err &
   pids[$(( id++))]=$!
 done
 
@@ -1,44 +1,271 @@
 #include <algorithm>
+#include <cctype>
+#include <cstdlib>
 #include <cstring>
 #include <exception>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 using namespace std;
 
 #include "boost/program_options.hpp"
 namespace po = boost::program_options;
 
+#include "polo/polo.hpp"
+using namespace polo;
+
+#include "csr.hpp"
+#include "csrfile.hpp"
+#include "dsstats.hpp"
+#include "mappedfile.hpp"
+#include "parallel.hpp"
+#include "registry.hpp"
+#include "shardplan.hpp"
+
+using index_t = int32_t;
+using value_t = float;
+
+struct chunk_t {
+  const char *begin, *end;
+  size_t firstline, nlines;
+};
+
+vector<chunk_t> make_chunks(const char *data, const size_t size,
+                            const size_t chunksize) {
+  vector<chunk_t> chunks;
+  const char *begin = data, *end = data + size;
+  while (begin < end) {
+    const char *last = begin + min(chunksize, size_t(end - begin));
+    if (last < end) {
+      const void *nl = memchr(last, '\n', end - last);
+      last = nl ? static_cast<const char *>(nl) + 1 : end;
+    }
+    chunks.push_back(chunk_t{begin, last, 0, 0});
+    begin = last;
+  }
+  return chunks;
+}
+
+size_t count_lines(const chunk_t &chunk) {
+  size_t nlines = count(chunk.begin, chunk.end, '\n');
+  if (chunk.end > chunk.begin && chunk.end[-1] != '\n')
+    nlines++;
+  return nlines;
+}
+
+template <class Function> void for_each_line(const chunk_t &chunk, Function f) {
+  const char *begin = chunk.begin;
+  size_t line = chunk.firstline;
+  while (begin < chunk.end) {
+    const void *nl = memchr(begin, '\n', chunk.end - begin);
+    const char *end = nl ? static_cast<const char *>(nl) : chunk.end;
+    f(line++, begin, end);
+    begin = end + 1;
+  }
+}
+
+struct partial_t {
+  vector<index_t> rowptr{0}, colind;
+  vector<value_t> values, labels;
+  vector<int> pieces;
+  index_t maxcol{-1};
+};
+
+const char *parse_number(const char *begin, const char *end, value_t &val) {
+  char token[64];
+  const size_t len = min<size_t>(end - begin, sizeof(token) - 1);
+  memcpy(token, begin, len);
+  token[len] = '\0';
+  char *last;
+  val = strtof(token, &last);
+  if (last == token)
+    throw runtime_error("malformed line: " + string(begin, end));
+  return begin + (last - token);
+}
+
+void parse_line(const char *begin, const char *end, const int piece,
+                partial_t &part) {
+  while (begin < end && isspace(*begin))
+    begin++;
+  if (begin == end)
+    return;
+
+  value_t label;
+  begin = parse_number(begin, end, label);
+  while (begin < end) {
+    while (begin < end && isspace(*begin))
+      begin++;
+    if (begin == end || *begin == '#')
+      break;
+    index_t col{0};
+    const char *colbegin = begin;
+    while (begin < end && *begin >= '0' && *begin <= '9')
+      col = 10 * col + (*begin++ - '0');
+    if (begin == colbegin || begin == end || *begin++ != ':' || col < 1)
+      throw runtime_error("malformed feature: " + string(colbegin, end));
+    value_t val;
+    begin = parse_number(begin, end, val);
+    part.colind.push_back(col - 1);
+    part.values.push_back(val);
+    part.maxcol = max(part.maxcol, col - 1);
+  }
+  part.labels.push_back(label);
+  part.rowptr.push_back(index_t(part.values.size()));
+  part.pieces.push_back(piece);
+}
+
+csrmatrix<value_t, index_t> gather(const vector<partial_t> &parts,
+                                   const index_t ncols, const int piece) {
+  csrmatrix<value_t, index_t> A;
+  A.ncols = ncols;
+  A.rowptr.push_back(0);
+  for (const auto &part : parts)
+    for (size_t row = 0; row < part.labels.size(); row++) {
+      if (piece > 0 && part.pieces[row] != piece)
+        continue;
+      A.colind.insert(end(A.colind), begin(part.colind) + part.rowptr[row],
+                      begin(part.colind) + part.rowptr[row + 1]);
+      A.values.insert(end(A.values), begin(part.values) + part.rowptr[row],
+                      begin(part.values) + part.rowptr[row + 1]);
+      A.labels.push_back(part.labels[row]);
+      A.rowptr.push_back(index_t(A.values.size()));
+    }
+  A.nrows = index_t(A.labels.size());
+  return A;
+}
+
 void split_files(const vector<string> &inputs, const vector<string> &outputs,
-                 const vector<int> &nums) {
+                 const vector<int> &nums, const unsigned int nthreads,
+                 const size_t chunksize, const bool binary, const bool whole,
+                 const bool balance) {
   if (inputs.size() != outputs.size())
     throw domain_error("inputs and outputs must have the same size");
   if (inputs.size() != nums.size())
     throw domain_error("nums must have the same size as inputs");
 
   for (size_t m = 0; m < inputs.size(); m++) {
-    ifstream input(inputs[m]);
-    if (!input)
-      throw runtime_error(inputs[m] + " could not be opened.");
+    const mappedfile input(inputs[m], MADV_SEQUENTIAL);
+    const size_t num = nums[m];
 
-    vector<ofstream> files(nums[m]);
+    vector<ofstream> files(binary ? 0 : num);
     int n = 0;
     for (auto &file : files) {
       n++;
-      file = ofstream(outputs[m] + "-" + to_string(n));
+      file = ofstream(outputs[m] + "-" + to_string(n), ios_base::binary);
       if (!file)
         throw runtime_error(outputs[m] + "-" + to_string(n) +
                             " could not be opened.");
     }
 
-    cout << "Splitting " << inputs[m] << " into " << nums[m]
+    cout << "Splitting " << inputs[m] << " into " << num
          << " pieces with name " << outputs[m] << "...\n";
 
-    string line;
-    n = 0;
-    while (getline(input, line))
-      files[(n++) % nums[m]] << line << endl;
+    vector<chunk_t> chunks = make_chunks(input.data(), input.size(), chunksize);
+    vector<partial_t> parts(binary ? chunks.size() : 0);
+    size_t nlines{0};
+    for (size_t first = 0; first < chunks.size(); first += nthreads) {
+      const size_t last = min(chunks.size(), first + nthreads);
+      parallel_for(last - first, nthreads, [&](const size_t idx) {
+        chunks[first + idx].nlines = count_lines(chunks[first + idx]);
+      });
+      for (size_t c = first; c < last; c++) {
+        chunks[c].firstline = nlines;
+        nlines += chunks[c].nlines;
+      }
+
+      if (binary) {
+        parallel_for(last - first, nthreads, [&](const size_t idx) {
+          const size_t c = first + idx;
+          for_each_line(chunks[c], [&](const size_t line, const char *begin,
+                                       const char *end) {
+            parse_line(begin, end, int(line % num) + 1, parts[c]);
+          });
+        });
+        continue;
+      }
+
+      vector<string> buffers((last - first) * num);
+      parallel_for(last - first, nthreads, [&](const size_t idx) {
+        const chunk_t &chunk = chunks[first + idx];
+        string *local = &buffers[idx * num];
+        for (size_t s = 0; s < num; s++)
+          local[s].reserve((chunk.end - chunk.begin) / num + 1024);
+        for_each_line(chunk, [&](const size_t line, const char *begin,
+                                 const char *end) {
+          string &buffer = local[line % num];
+          buffer.append(begin, end);
+          buffer.push_back('\n');
+        });
+      });
+      parallel_for(num, nthreads, [&](const size_t s) {
+        for (size_t idx = 0; idx < last - first; idx++) {
+          const string &buffer = buffers[idx * num + s];
+          files[s].write(buffer.data(), buffer.size());
+        }
+      });
+    }
+
+    if (!binary)
+      continue;
+
+    index_t ncols{0};
+    for (const auto &part : parts)
+      ncols = max(ncols, part.maxcol + 1);
+
+    if (balance) {
+      vector<index_t> rownnz;
+      rownnz.reserve(nlines);
+      for (const auto &part : parts)
+        for (size_t row = 0; row < part.labels.size(); row++)
+          rownnz.push_back(part.rowptr[row + 1] - part.rowptr[row]);
+      const shardplan plan(begin(rownnz), end(rownnz), int(num));
+      size_t row{0};
+      for (auto &part : parts)
+        for (auto &piece : part.pieces)
+          piece = plan.shards[row++];
+      cout << "Balanced the nonzeros of the pieces to within "
+           << plan.imbalance() << " times their average.\n";
+    }
+
+    mutex output;
+    vector<shardfile> manifest(2 * (num + 1));
+    parallel_for(num + 1, nthreads, [&](const size_t s) {
+      if (s == 0 && !whole)
+        return;
+      auto A = gather(parts, ncols, int(s));
+      const dsstats<value_t, index_t> stats(A.view());
+      const string outfile = outputs[m] + "-" + to_string(s);
+      stats.save(outfile + ".stats");
+      csrfile::save(A.view(), outfile + ".csr");
+      move(A).todata().save(outfile + ".bin");
+
+      for (const string format : {"bin", "csr"}) {
+        const mappedfile file(outfile + "." + format, MADV_SEQUENTIAL);
+        manifest[2 * s + (format == "csr")] =
+            shardfile{int(s),
+                      format,
+                      outfile + "." + format,
+                      file.size(),
+                      checksum(file.data(), file.size()),
+                      stats.nsamples,
+                      stats.nfeatures,
+                      stats.nnz};
+      }
+
+      lock_guard<mutex> lock(output);
+      cout << "Saved " << stats.nsamples << " samples with " << stats.nfeatures
+           << " features and " << stats.nnz << " nonzeros to " << outfile
+           << ".bin (max 2-norm: " << stats.maxnorm
+           << ", L: " << stats.lipschitzbound << ").\n";
+    });
+
+    if (!whole)
+      manifest.erase(begin(manifest), begin(manifest) + 2);
+    registry<value_t, index_t>::write(outputs[m] + ".manifest", manifest);
   }
 }
 
@@ -51,6 +278,9 @@ int main(int argc, char *argv[]) {
   vector<string> inputs;
   vector<string> outputs;
   vector<int> nums;
+  unsigned int nthreads;
+  size_t chunksize;
+  bool binary, whole, balance;
 
   po::options_description options("Options");
   options.add_options()("help,h", "prints the help message")(
@@ -58,7 +288,20 @@ int main(int argc, char *argv[]) {
       "sets the input file(s) to split")("output,o",
                                          po::value<vector<string>>(&outputs),
                                          "sets the output file(s) to write")(
-      "num,n", po::value<vector<int>>(&nums), "sets the number of files");
+      "num,n", po::value<vector<int>>(&nums), "sets the number of files")(
+      "nthreads,j",
+      po::value<unsigned int>(&nthreads)->default_value(
+          max(thread::hardware_concurrency(), 1u)),
+      "sets the number of threads")(
+      "chunk-size,c", po::value<size_t>(&chunksize)->default_value(64),
+      "sets the size of the chunks processed by each thread in MBs")(
+      "binary,b", po::bool_switch(&binary),
+      "parses the libsvm input and writes the pieces in binary format")(
+      "whole,w", po::bool_switch(&whole),
+      "also writes the whole input as piece 0 in binary format")(
+      "balance,B", po::bool_switch(&balance),
+      "assigns each line to the piece with the fewest nonzeros so far instead "
+      "of round-robin (binary format only)");
 
   po::variables_map vm;
   po::store(po::parse_command_line(argc, argv, options), vm);
@@ -79,13 +322,34 @@ int main(int argc, char *argv[]) {
     cerr << "Numbers are not defined.\n";
     cout << options << '\n';
     return 3;
+  } else if ((whole || balance) && !binary) {
+    cerr << "Whole and balanced inputs can only be written in binary "
+            "format.\n";
+    cout << options << '\n';
+    return 4;
+  } else if (nthreads < 1 || chunksize < 1) {
+    cerr << "Number of threads and chunk size must be at least 1.\n";
+    cout << options << '\n';
+    return 4;
   }
+  for (const int num : nums)
+    if (num < 1) {
+      cerr << "Numbers must be at least 1.\n";
+      cout << options << '\n';
+      return 3;
+    }
 
   cout << "Input files: " << vm["input"].as<vector<string>>() << '\n';
   cout << "Output files: " << vm["output"].as<vector<string>>() << '\n';
   cout << "Number of files: " << vm["num"].as<vector<int>>() << '\n';
 
-  split_files(inputs, outputs, nums);
+  try {
+    split_files(inputs, outputs, nums, nthreads, chunksize * 1024 * 1024,
+                binary, whole, balance);
+  } catch (const exception &ex) {
+    cerr << "Error occurred: " << ex.what() << '\n';
+    return 5;
+  }
 
   return 0;
 }
@@ -2,10 +2,9 @@
 #include <cstdlib>
 #include <fstream>
 #include <iostream>
-#include <sstream>
+#include <memory>
 #include <stdexcept>
 #include <string>
-#include <tuple>
 using namespace std;
 
 #include "boost/program_options.hpp"
@@ -14,6 +13,8 @@ namespace po = boost::program_options;
 #include "polo/polo.hpp"
 using namespace polo;
 
+#include "registry.hpp"
+
 template <class value_t, class index_t>
 void printinfo(polo::loss::data<value_t, index_t> dataset, const index_t nrows,
                const index_t ncols) {
@@ -52,35 +53,24 @@ int main(int argc, char *argv[]) {
     return 0;
   }
 
-  ifstream dslist("data/datasets.lst");
-  if (!dslist) {
-    cerr << "Error occured: data/datasets.lst could not be opened.\n";
+  unique_ptr<const registry<value_t, index_t>> datasets;
+  try {
+    datasets.reset(new registry<value_t, index_t>("data/datasets.lst"));
+  } catch (const exception &ex) {
+    cerr << "Error occurred: " << ex.what() << '\n';
     return 1;
   }
 
-  vector<tuple<string, bool, index_t, index_t>> datasets;
-  string line;
-  while (getline(dslist, line)) {
-    istringstream ss(line);
-    string dsname;
-    bool dense;
-    index_t nsamples, nfeatures;
-    ss >> dsname >> boolalpha >> dense >> nsamples >> nfeatures;
-    datasets.emplace_back(dsname, dense, nsamples, nfeatures);
-  }
-
   if (!vm.count("dataset-id")) {
     cerr << "Dataset ID is not set.\n";
     cout << options << '\n';
     return 2;
-  } else if (id >= datasets.size()) {
+  } else if (id >= datasets->size()) {
     cerr << "Dataset ID is set to " << id << ". Supported ID's are:\n";
-    for (size_t idx = 0; idx < datasets.size(); idx++)
-      cerr << "  - " << idx << ") " << get<0>(datasets[idx]) << "("
-           << (get<1>(datasets[idx]) ? "dense" : "sparse") << ")\n";
+    datasets->print(cerr);
     return 2;
   }
-  const auto choice = datasets[id];
+  const auto &choice = (*datasets)[id];
 
   if (!vm.count("suffix")) {
     cerr << "Suffix is not set.\n";
@@ -88,7 +78,7 @@ int main(int argc, char *argv[]) {
     return 3;
   }
 
-  const string dsname = "data/" + get<0>(choice) + "-" + suffix;
+  const string dsname = "data/" + choice.name + "-" + suffix;
   ifstream dsfile(dsname);
   if (!dsfile) {
     cerr << "Error occurred: " << dsname << " could not be opened.\n";
@@ -98,9 +88,9 @@ int main(int argc, char *argv[]) {
 
   cout << "Loading svm file from " << dsname << "...\n";
   polo::loss::data<value_t, index_t> dataset;
-  if (get<1>(choice))
-    dataset = utility::reader<value_t, index_t>::svm({dsname}, get<2>(choice),
-                                                     get<3>(choice));
+  if (choice.dense)
+    dataset = utility::reader<value_t, index_t>::svm({dsname}, choice.nsamples,
+                                                     choice.nfeatures);
   else
     dataset = utility::reader<value_t, index_t>::svm({dsname});
 
@@ -110,7 +100,7 @@ int main(int argc, char *argv[]) {
   dataset.save(dsname + ".bin");
 
   cout << "Loading the binary file to test...\n";
-  dataset.load(dsname + ".bin", get<1>(choice));
+  dataset.load(dsname + ".bin", choice.dense);
 
   printinfo(dataset, 3, 5);
 
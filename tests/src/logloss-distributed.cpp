@@ -1,13 +1,14 @@
 #include <algorithm>
 #include <chrono>
+#include <cstdint>
 #include <cstdlib>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <random>
-#include <sstream>
 #include <string>
-#include <tuple>
 #include <utility>
+#include <vector>
 using namespace std;
 
 #include "boost/program_options.hpp"
@@ -23,21 +24,51 @@ namespace po = boost::program_options;
 using namespace polo;
 
 #include "auxiliary.hpp"
+#include "csrfile.hpp"
+#include "csrlogistic.hpp"
+#include "dsstats.hpp"
+#include "encoders.hpp"
+#include "instrument.hpp"
+#include "registry.hpp"
+#include "streamlogger.hpp"
+#include "telemetry.hpp"
 
 using index_t = int32_t;
 using value_t = float;
 
+const vector<string> encnames{"identity",  "sparse", "quantize8",
+                               "quantize4", "topk",   "half"};
+
+/* solves with the encoder, prefixing its messages for telemetry if traced */
+template <class Algorithm, class Loss, class Logger, class Encoder>
+void solve(Algorithm &alg, Loss &loss, Logger &log, const index_t K,
+           Encoder &enc, const shared_ptr<tracestate> &state) {
+  const terminator::iteration<value_t, index_t> term(K);
+  if (state) {
+    traced<Encoder> tenc(enc, state);
+    alg.solve(loss, log, term, tenc);
+  } else
+    alg.solve(loss, log, term, enc);
+}
+
 int main(int argc, char *argv[]) {
   size_t id;
-  index_t fid, K;
+  index_t fid, K, W;
   value_t lambda1;
-  string maddress, saddress;
+  double fraction;
+  uint64_t seed;
+  int mport, sport, wtimeout, stimeout;
+  bool delta, mmap, profile, trace;
+  string maddress, saddress, encname;
 
   po::options_description options("Options");
   options.add_options()("help,h", "prints the help message")(
       "dataset-id,d", po::value<size_t>(&id),
       "sets the id of the dataset to load")(
       "file-id,f", po::value<index_t>(&fid), "sets the file id to load")(
+      "nworkers,W", po::value<index_t>(&W)->default_value(0),
+      "sets the number of workers, whose files 1, ..., W give L when file "
+      "0 has no statistics")(
       "lambda1,l", po::value<value_t>(&lambda1)->default_value(1e-6),
       "sets the l1 penalty")("max-iter,K",
                              po::value<index_t>(&K)->default_value(100000),
@@ -45,7 +76,32 @@ int main(int argc, char *argv[]) {
       "master-address,m", po::value<string>(&maddress),
       "sets the master's IP address")("scheduler-address,s",
                                       po::value<string>(&saddress),
-                                      "sets the scheduler's IP address");
+                                      "sets the scheduler's IP address")(
+      "master-port", po::value<int>(&mport)->default_value(50000),
+      "sets the master's port")(
+      "scheduler-port", po::value<int>(&sport)->default_value(40000),
+      "sets the first of the scheduler's three consecutive ports")(
+      "worker-timeout", po::value<int>(&wtimeout)->default_value(10000),
+      "sets the workers' timeout in milliseconds")(
+      "scheduler-timeout", po::value<int>(&stimeout)->default_value(20000),
+      "sets the scheduler's timeout in milliseconds")(
+      "encoder,e", po::value<string>(&encname)->default_value("identity"),
+      "sets the encoder of the exchanged vectors (identity, sparse, "
+      "quantize8, quantize4, topk, half); the lossy ones compress only the "
+      "workers' gradients")(
+      "topk-fraction", po::value<double>(&fraction)->default_value(0.01),
+      "sets the fraction of the shard's columns sent by the topk encoder")(
+      "quantizer-seed", po::value<uint64_t>(&seed)->default_value(0),
+      "sets the seed of the stochastic rounding of the quantize encoders")(
+      "telemetry", po::bool_switch(&trace),
+      "records the workers' staleness and round trips on the master (set on "
+      "the master and all workers)")(
+      "delta-log,D", po::bool_switch(&delta),
+      "delta-encodes the logged states against the previous ones")(
+      "mmap", po::bool_switch(&mmap),
+      "maps the dataset in CSR format instead of loading it")(
+      "profile,P", po::bool_switch(&profile),
+      "records per-phase timings and hardware counters");
 
   po::variables_map vm;
   po::store(po::parse_command_line(argc, argv, options), vm);
@@ -60,35 +116,45 @@ int main(int argc, char *argv[]) {
     cerr << "Scheduler's address is not set.\n";
     cout << options << '\n';
     return 1;
+  } else if (find(begin(encnames), end(encnames), encname) == end(encnames)) {
+    cerr << "Encoder " << encname << " is not supported.\n";
+    cout << options << '\n';
+    return 1;
+  } else if (fraction <= 0 || fraction > 1) {
+    cerr << "Top-k fraction must be in (0, 1].\n";
+    cout << options << '\n';
+    return 1;
+  } else if (mport < 1 || mport > 65535 || sport < 1 || sport > 65533) {
+    cerr << "Ports must be in [1, 65535].\n";
+    cout << options << '\n';
+    return 1;
   }
 
-  ifstream dslist("data/datasets.lst");
-  if (!dslist) {
-    cerr << "Error occured: data/datasets.lst could not be opened.\n";
+  unique_ptr<const registry<value_t, index_t>> datasets;
+  try {
+    datasets.reset(new registry<value_t, index_t>("data/datasets.lst"));
+  } catch (const exception &ex) {
+    cerr << "Error occurred: " << ex.what() << '\n';
     return 2;
   }
 
-  vector<tuple<string, bool, index_t, index_t>> datasets;
-  string line;
-  while (getline(dslist, line)) {
-    istringstream ss(line);
-    string dsname;
-    bool dense;
-    index_t N, d;
-    ss >> dsname >> boolalpha >> dense >> N >> d;
-    datasets.emplace_back(move(dsname), dense, N, d);
-  }
+  profiler prof(profile);
+#ifdef MASTER
+  const string role{"master"};
+#elif defined WORKER
+  const string role{"worker"};
+#else
+  const string role{"scheduler"};
+#endif
 
 #ifdef WORKER
   if (!vm.count("dataset-id")) {
     cerr << "Dataset ID is not set.\n";
     cout << options << '\n';
     return 3;
-  } else if (id >= datasets.size()) {
+  } else if (id >= datasets->size()) {
     cerr << "Dataset ID is set to " << id << ". Supported ID's are:\n";
-    for (size_t idx = 0; idx < datasets.size(); idx++)
-      cerr << "  - " << idx << ") " << get<0>(datasets[idx]) << "("
-           << (get<1>(datasets[idx]) ? "dense" : "sparse") << ")\n";
+    datasets->print(cerr);
     return 3;
   }
 
@@ -98,29 +164,83 @@ int main(int argc, char *argv[]) {
     return 4;
   }
 
-  const string dsfile =
-      "data/" + get<0>(datasets[id]) + "-" + to_string(fid) + ".bin";
+  const string dsfile = datasets->path(id, fid, mmap ? ".csr" : ".bin");
   loss::data<value_t, index_t> dataset;
+  mappedcsr<value_t, index_t> mapped;
   try {
-    cout << "Loading dataset from " << dsfile << "...\n";
-    dataset.load(dsfile, get<1>(datasets[id]));
-    printinfo(dataset, 3, 5);
+    const scope s(prof["load"]);
+    if (mmap) {
+      cout << "Mapping dataset from " << dsfile << "...\n";
+      mapped = datasets->map(id, fid);
+    } else {
+      cout << "Loading dataset from " << dsfile << "...\n";
+      dataset = datasets->load(id, fid);
+      printinfo(dataset, 3, 5);
+    }
   } catch (const exception &ex) {
     cerr << "Error occurred: " << ex.what() << '\n';
     return 5;
   }
-  loss::logistic<value_t, index_t> logloss(dataset);
+  const anyloss<value_t, index_t> logloss =
+      mmap ? anyloss<value_t, index_t>(
+                 csrlogistic<value_t, index_t>(mapped.view()))
+           : anyloss<value_t, index_t>(
+                 loss::logistic<value_t, index_t>(dataset));
+
+  auto loss = instrument(logloss, prof["oracle"]);
 
-  auto loss = logloss;
+  /* the gradients of the shard are zero outside the columns it touches */
+  const vector<index_t> columns =
+      mmap ? touchedcolumns(mapped.view())
+           : touchedcolumns(csrmatrix<value_t, index_t>(dataset).view());
+  cout << "The shard touches " << columns.size() << " columns.\n";
 #else
   auto loss = nullptr;
+  const vector<index_t> columns;
 #endif
 
-  const index_t N = get<2>(datasets[id]);
-  const index_t d = get<3>(datasets[id]);
-  const value_t L = 0.25 * N;
+  const index_t N = (*datasets)[id].nsamples;
+  const index_t d = (*datasets)[id].nfeatures;
+  const string statsfile = datasets->path(id, 0, ".stats");
+  value_t L = 0.25 * N;
+  try {
+    dsstats<value_t, index_t> stats;
+    stats.load(statsfile);
+    L = stats.lipschitzbound;
+    cout << "Using L = " << L << " from " << statsfile << ".\n";
+  } catch (const exception &ex) {
+    /* the sum of the shards' constants bounds that of the whole loss */
+    value_t sum{0};
+    index_t shard{1};
+    for (; shard <= W; shard++)
+      try {
+        dsstats<value_t, index_t> stats;
+        stats.load(datasets->path(id, shard, ".stats"));
+        sum += stats.lipschitzbound;
+      } catch (const exception &) {
+        break;
+      }
+    if (W > 0 && shard > W) {
+      L = sum;
+      cout << "Using L = " << L << " from the statistics of " << W
+           << " files.\n";
+    } else
+      cout << "Using L = " << L << " for unit-norm samples (" << ex.what()
+           << ").\n";
+  }
+#ifdef WORKER
+  try {
+    dsstats<value_t, index_t> stats;
+    stats.load(datasets->path(id, fid, ".stats"));
+    cout << "The shard has " << stats.nnz << " nonzeros and L = "
+         << stats.lipschitzbound << ".\n";
+  } catch (const exception &) {
+  }
+#endif
 
-  string suffix{"ps-piag"};
+  const string suffix =
+      (encname == "identity" ? "ps-piag" : "ps-piag-" + encname) +
+      (trace ? "-traced" : "");
 
   algorithm::proxgradient<value_t, index_t, boosting::aggregated,
                           step::constant, smoothing::none, prox::l1norm,
@@ -130,11 +250,10 @@ int main(int argc, char *argv[]) {
   alg.step_parameters(1 / L);
   alg.prox_parameters(lambda1);
   execution::paramserver::options psopts;
-  psopts.worker_timeout(10000);
-  psopts.scheduler_timeout(20000);
-  psopts.worker_timeout(10000);
-  psopts.master(maddress, 50000);
-  psopts.scheduler(saddress, 40000, 40001, 40002);
+  psopts.worker_timeout(wtimeout);
+  psopts.scheduler_timeout(stimeout);
+  psopts.master(maddress, mport);
+  psopts.scheduler(saddress, sport, sport + 1, sport + 2);
   alg.execution_parameters(psopts);
 
   vector<value_t> x0(d);
@@ -144,36 +263,151 @@ int main(int argc, char *argv[]) {
             [&](const value_t v) -> value_t { return dist(generator); });
   alg.initialize(x0);
 
+#ifdef MASTER
+  const string logfile = "results/" + (*datasets)[id].name + "-" +
+                         to_string(fid) + "-" + suffix + ".bin";
+  unique_ptr<streamlogger<value_t, index_t>> plogger;
+  try {
+    plogger.reset(
+        new streamlogger<value_t, index_t>(logfile, lambda1, d, delta));
+  } catch (const exception &ex) {
+    cerr << "Error occurred: " << ex.what() << '\n';
+    return 6;
+  }
+  auto &logger = *plogger;
+#else
   customlogger<value_t, index_t> logger;
-  encoder::identity<value_t, index_t> enc;
+#endif
+  encoder::identity<value_t, index_t> identity;
+  encoders::dense<value_t, index_t> dense;
+  encoders::sparse<value_t, index_t> sparse(columns);
+#ifdef WORKER
+  const string lossy = encname;
+#else
+  const string lossy = "sparse";
+#endif
+  encoders::quantized<value_t, index_t> quantized(
+      lossy == "quantize4" ? 4 : 8, seed,
+      vm.count("file-id") ? uint64_t(fid) : 0, columns);
+  encoders::topk<value_t, index_t> topk(
+      fraction, d, uint32_t(vm.count("file-id") ? fid : index_t{0}),
+      columns);
+  encoders::half<value_t, index_t> half(columns);
+
+#ifdef SCHEDULER
+  const string prefix = "results/" + suffix + "-" + role;
+#else
+  const string prefix = "results/" + (*datasets)[id].name + "-" +
+                        to_string(fid) + "-" + suffix + "-" + role;
+#endif
+  unique_ptr<telemetry> recorder;
+  shared_ptr<tracestate> state;
+  if (trace) {
+#ifdef MASTER
+    try {
+      recorder.reset(new telemetry(prefix + "-telemetry.bin"));
+    } catch (const exception &ex) {
+      cerr << "Error occurred: " << ex.what() << '\n';
+      return 6;
+    }
+    state = make_shared<tracestate>(*recorder);
+#else
+    state = make_shared<tracestate>(
+        uint32_t(vm.count("file-id") ? fid : index_t{0}));
+#endif
+  }
 
   cout << "Experiment will run with:\n";
-  cout << "  - ds     : " << get<0>(datasets[id]) << '\n';
+  cout << "  - ds     : " << (*datasets)[id].name << '\n';
   cout << "  - suffix : " << suffix << '\n';
+  cout << "  - encoder: " << encname << '\n';
   cout << "  - lambda1: " << lambda1 << '\n';
   cout << "  - K      : " << K << '\n';
-  cout << "Scheduler is on " << saddress << '\n';
-  cout << "Master is on " << maddress << '\n';
+  cout << "Scheduler is on " << saddress << ':' << sport << '-' << sport + 2
+       << '\n';
+  cout << "Master is on " << maddress << ':' << mport << '\n';
   auto tstart = chrono::high_resolution_clock::now();
 
-  alg.solve(loss, logger, terminator::iteration<value_t, index_t>(K), enc);
+  auto log = instrument(logger, prof["logger"]);
+  {
+    const scope s(prof["solve"]);
+    if (encname == "identity" && !trace)
+      alg.solve(loss, log, terminator::iteration<value_t, index_t>(K),
+                identity);
+    else if (encname == "identity")
+      solve(alg, loss, log, K, dense, state);
+    else if (lossy == "quantize8" || lossy == "quantize4")
+      solve(alg, loss, log, K, quantized, state);
+    else if (lossy == "topk")
+      solve(alg, loss, log, K, topk, state);
+    else if (lossy == "half")
+      solve(alg, loss, log, K, half, state);
+    else
+      solve(alg, loss, log, K, sparse, state);
+  }
+  auto tsolved = chrono::high_resolution_clock::now();
+
+  uint64_t messages{0}, bytes{0};
+  if (lossy == "quantize8" || lossy == "quantize4") {
+    messages = quantized.messages();
+    bytes = quantized.bytes();
+  } else if (lossy == "topk") {
+    messages = topk.messages();
+    bytes = topk.bytes();
+  } else if (lossy == "half") {
+    messages = half.messages();
+    bytes = half.bytes();
+  } else if (encname != "identity") {
+    messages = sparse.messages();
+    bytes = sparse.bytes();
+  } else if (trace) {
+    messages = dense.messages();
+    bytes = dense.bytes();
+  }
+  if (messages > 0) {
+    cout << "Encoded " << messages << " messages of " << bytes / messages
+         << " bytes on average (" << d * sizeof(value_t)
+         << " bytes dense).\n";
+    const string wirefile = prefix + "-wire.csv";
+    ofstream file(wirefile);
+    file << "encoder,messages,bytes,dense-bytes,seconds\n";
+    file << encname << ',' << messages << ',' << bytes << ','
+         << messages * d * sizeof(value_t) << ','
+         << chrono::duration<double>(tsolved - tstart).count() << '\n';
+    if (!file) {
+      cerr << "Error occurred: " << wirefile << " could not be written.\n";
+      return 6;
+    }
+  }
 
 #ifdef MASTER
-  const string logfile = "results/" + get<0>(datasets[id]) + "-" +
-                         to_string(fid) + "-" + suffix + ".bin";
-  cout << "Writing the logged states to " << logfile << "...\n";
-  ofstream file(logfile, ios_base::binary);
-  const index_t numlogs = distance(begin(logger), end(logger));
-  file.write(reinterpret_cast<const char *>(&lambda1), sizeof(value_t));
-  file.write(reinterpret_cast<const char *>(&numlogs), sizeof(index_t));
-  file.write(reinterpret_cast<const char *>(&d), sizeof(index_t));
-  for (const auto log : logger) {
-    const auto k = log.getk();
-    const auto t = log.gett();
-    const auto &x = log.getx();
-    file.write(reinterpret_cast<const char *>(&k), sizeof(index_t));
-    file.write(reinterpret_cast<const char *>(&t), sizeof(value_t));
-    file.write(reinterpret_cast<const char *>(&x[0]), d * sizeof(value_t));
+  if (recorder) {
+    const string telemetryfile = prefix + "-telemetry.csv";
+    try {
+      recorder->close();
+      recorder->save(telemetryfile);
+    } catch (const exception &ex) {
+      cerr << "Error occurred: " << ex.what() << '\n';
+      return 6;
+    }
+    cout << "Received " << recorder->nupdates()
+         << " gradients with staleness up to " << recorder->maxstaleness()
+         << " and round trips of " << recorder->roundtrip(0.5) / 1000.
+         << "ms (median), " << recorder->roundtrip(0.999) / 1000.
+         << "ms (99.9%) against the worker timeout of " << wtimeout
+         << "ms.\n";
+    cout << "Saved the telemetry to " << telemetryfile << ".\n";
+  }
+
+  cout << "Flushing the logged states to " << logfile << "...\n";
+  try {
+    const scope s(prof["close"]);
+    logger.close();
+    cout << "Wrote " << logger.size() << " states in " << logger.bytes() / 1024
+         << "KBs with " << logger.nstalls() << " stalls.\n";
+  } catch (const exception &ex) {
+    cerr << "Error occurred: " << ex.what() << '\n';
+    return 6;
   }
 #endif
 
@@ -185,5 +419,17 @@ int main(int argc, char *argv[]) {
   cout << "Experiment took " << hours << ':' << minutes << ':' << seconds
        << ".\n";
 
+  if (profile) {
+    const string profilefile = prefix + "-profile.csv";
+    try {
+      prof.save(profilefile);
+      cout << "Saved the profile" << (prof.hascounters() ? "" : " (no counters)")
+           << " to " << profilefile << ".\n";
+    } catch (const exception &ex) {
+      cerr << "Error occurred: " << ex.what() << '\n';
+      return 7;
+    }
+  }
+
   return 0;
 }
@@ -1,10 +1,11 @@
 #include <algorithm>
 #include <chrono>
+#include <cstdint>
 #include <cstdlib>
 #include <fstream>
 #include <iostream>
-#include <random>
-#include <sstream>
+#include <limits>
+#include <memory>
 #include <string>
 #include <utility>
 using namespace std;
@@ -16,20 +17,44 @@ namespace po = boost::program_options;
 using namespace polo;
 
 #include "auxiliary.hpp"
+#include "csrfile.hpp"
+#include "csrlogistic.hpp"
+#include "dsstats.hpp"
+#include "instrument.hpp"
+#include "numa.hpp"
+#include "parallel.hpp"
+#include "registry.hpp"
+#include "rng.hpp"
+#include "scaling.hpp"
+#include "streamlogger.hpp"
+#include "variants.hpp"
 
 using index_t = int32_t;
 using value_t = float;
 
 int main(int argc, char *argv[]) {
   size_t id;
-  index_t fid, K, M, Md, W;
-  value_t lambda1;
+  index_t fid, K, M, Md;
+  vector<index_t> Ws;
+  vector<string> variants;
+  value_t lambda1, target;
+  uint64_t seed;
+  bool delta, mmap, numa, profile, scaling;
 
   po::options_description options("Options");
   options.add_options()("help,h", "prints the help message")(
       "dataset-id,d", po::value<size_t>(&id),
       "sets the id of the dataset to load")(
       "file-id,f", po::value<index_t>(&fid), "sets the file id to load")(
+      "algorithm,a",
+      po::value<vector<string>>(&variants)
+          ->multitoken()
+          ->default_value(vector<string>{"serial-mb-amsgrad"},
+                          "serial-mb-amsgrad"),
+      "sets the algorithms to run, one after another (serial-mb, "
+      "serial-mb-adam, serial-mb-amsgrad, serial-mb-amsgrad-lazy, "
+      "serial-mb-adam-block, consistent-mb-adam-block, "
+      "inconsistent-mb-adam-block)")(
       "batch-size,M", po::value<index_t>(&M)->default_value(1000),
       "sets the size of the mini-batches")(
       "block-size,B", po::value<index_t>(&Md)->default_value(1000),
@@ -38,8 +63,25 @@ int main(int argc, char *argv[]) {
       "sets the l1 penalty")("max-iter,K",
                              po::value<index_t>(&K)->default_value(100000),
                              "sets the maximum number of iterations")(
-      "nworkers,W", po::value<index_t>(&W),
-      "sets the number of worker processes");
+      "nworkers,W", po::value<vector<index_t>>(&Ws)->multitoken(),
+      "sets the numbers of threads of the (in)consistent algorithms")(
+      "seed,s", po::value<uint64_t>(&seed)->default_value(0),
+      "sets the seed of the initial point and the samplers")(
+      "scaling,S", po::bool_switch(&scaling),
+      "reports throughput, time to target and speedup over W (1, ..., "
+      "number of CPUs unless set)")(
+      "target,T", po::value<value_t>(&target),
+      "sets the target objective of the scaling report (default: the best "
+      "objective reached by all runs)")(
+      "delta-log,D", po::bool_switch(&delta),
+      "delta-encodes the logged states against the previous ones")(
+      "mmap", po::bool_switch(&mmap),
+      "maps the dataset in CSR format instead of loading it")(
+      "numa,N", po::bool_switch(&numa),
+      "splits the rows across NUMA nodes and pins the solver threads to "
+      "them round-robin; the mini-batches stay those of the whole dataset")(
+      "profile,P", po::bool_switch(&profile),
+      "records per-phase timings and hardware counters");
 
   po::variables_map vm;
   po::store(po::parse_command_line(argc, argv, options), vm);
@@ -50,31 +92,21 @@ int main(int argc, char *argv[]) {
     return 0;
   }
 
-  ifstream dslist("data/datasets.lst");
-  if (!dslist) {
-    cerr << "Error occured: data/datasets.lst could not be opened.\n";
+  unique_ptr<const registry<value_t, index_t>> datasets;
+  try {
+    datasets.reset(new registry<value_t, index_t>("data/datasets.lst"));
+  } catch (const exception &ex) {
+    cerr << "Error occurred: " << ex.what() << '\n';
     return 1;
   }
 
-  vector<pair<string, bool>> datasets;
-  string line;
-  while (getline(dslist, line)) {
-    istringstream ss(line);
-    string dsname;
-    bool dense;
-    ss >> dsname >> boolalpha >> dense;
-    datasets.emplace_back(move(dsname), dense);
-  }
-
   if (!vm.count("dataset-id")) {
     cerr << "Dataset ID is not set.\n";
     cout << options << '\n';
     return 2;
-  } else if (id >= datasets.size()) {
+  } else if (id >= datasets->size()) {
     cerr << "Dataset ID is set to " << id << ". Supported ID's are:\n";
-    for (size_t idx = 0; idx < datasets.size(); idx++)
-      cerr << "  - " << idx << ") " << datasets[idx].first << "("
-           << (datasets[idx].second ? "dense" : "sparse") << ")\n";
+    datasets->print(cerr);
     return 2;
   }
 
@@ -84,141 +116,172 @@ int main(int argc, char *argv[]) {
     return 3;
   }
 
-  const string dsfile =
-      "data/" + datasets[id].first + "-" + to_string(fid) + ".bin";
+  for (const auto &variant : variants)
+    if (!ismbvariant(variant)) {
+      cerr << "Algorithm " << variant << " is not supported.\n";
+      cout << options << '\n';
+      return 5;
+    }
+  if (scaling && !vm.count("nworkers"))
+    for (index_t W = 1; W <= index_t(allowedcpus().size()); W++)
+      Ws.push_back(W);
+  if (Ws.empty() &&
+      any_of(begin(variants), end(variants),
+             [](const string &variant) { return isthreaded(variant); })) {
+    cerr << "Number of workers is not set.\n";
+    cout << options << '\n';
+    return 5;
+  } else if (any_of(begin(Ws), end(Ws),
+                    [](const index_t W) { return W < 1; })) {
+    cerr << "Number of workers must be at least 1.\n";
+    cout << options << '\n';
+    return 5;
+  }
+
+  const string dsfile = datasets->path(id, fid, mmap ? ".csr" : ".bin");
+  profiler prof(profile);
   loss::data<value_t, index_t> dataset;
+  mappedcsr<value_t, index_t> mapped;
   try {
-    cout << "Loading dataset from " << dsfile << "...\n";
-    dataset.load(dsfile, datasets[id].second);
-    printinfo(dataset, 3, 5);
+    const scope s(prof["load"]);
+    if (mmap) {
+      cout << "Mapping dataset from " << dsfile << "...\n";
+      mapped = datasets->map(id, fid);
+    } else {
+      cout << "Loading dataset from " << dsfile << "...\n";
+      dataset = datasets->load(id, fid);
+      printinfo(dataset, 3, 5);
+    }
   } catch (const exception &ex) {
     cerr << "Error occurred: " << ex.what() << '\n';
     return 4;
   }
-  loss::logistic<value_t, index_t> logloss(dataset);
-
-  const index_t N = dataset.nsamples();
-  const index_t d = dataset.nfeatures();
-  const value_t L = 0.25 * M;
-  const index_t B = N / M;
-
-#ifdef SERIAL_MB
-  algorithm::proxgradient<value_t, index_t, boosting::none, step::constant,
-                          smoothing::none, prox::l1norm, execution::serial>
-      alg;
-  alg.step_parameters(1 / L / B);
-  string suffix{"serial-mb"};
-#elif defined SERIAL_MB_ADAM
-  algorithm::proxgradient<value_t, index_t, boosting::momentum, step::constant,
-                          smoothing::rmsprop, prox::l1norm, execution::serial>
-      alg;
-  alg.step_parameters(1. / B);
-  alg.boosting_parameters(0.9, 0.1);
-  alg.smoothing_parameters(0.999, 1E-8);
-  string suffix = "serial-mb-adam-" + to_string(M);
-#elif defined SERIAL_MB_AMSGRAD
-  algorithm::proxgradient<value_t, index_t, boosting::momentum, step::constant,
-                          smoothing::amsgrad, prox::l1norm, execution::serial>
-      alg;
-  alg.step_parameters(1. / B);
-  alg.boosting_parameters(0.9, 0.1);
-  alg.smoothing_parameters(0.999, 1E-8);
-  string suffix = "serial-mb-amsgrad-" + to_string(M);
-#elif defined SERIAL_MB_ADAM_BLOCK
-#define BLOCK
-  algorithm::proxgradient<value_t, index_t, boosting::momentum, step::constant,
-                          smoothing::rmsprop, prox::l1norm, execution::serial>
-      alg;
-  alg.step_parameters(1. / B);
-  alg.boosting_parameters(0.9, 0.1);
-  alg.smoothing_parameters(0.999, 1E-8);
-  string suffix = "serial-mb-adam-block-" + to_string(Md);
-#elif defined CONSISTENT_MB_ADAM_BLOCK
-#define BLOCK
-  if (!vm.count("nworkers")) {
-    cerr << "Number of workers is not set.\n";
-    cout << options << '\n';
-    return 5;
+  const anyloss<value_t, index_t> logloss =
+      mmap ? anyloss<value_t, index_t>(
+                 csrlogistic<value_t, index_t>(mapped.view()))
+           : anyloss<value_t, index_t>(
+                 loss::logistic<value_t, index_t>(dataset));
+
+  const index_t N = mmap ? mapped.view().nrows : dataset.nsamples();
+  const index_t d = mmap ? mapped.view().ncols : dataset.nfeatures();
+  csrmatrix<value_t, index_t> rows;
+  if (!mmap && find(begin(variants), end(variants),
+                    "serial-mb-amsgrad-lazy") != end(variants))
+    rows = csrmatrix<value_t, index_t>(dataset);
+  const csrview<value_t, index_t> view = mmap ? mapped.view() : rows.view();
+  numapartition<value_t, index_t> partition;
+  if (numa) {
+    const scope s(prof["partition"]);
+    partition = mmap ? numapartition<value_t, index_t>(mapped.view())
+                     : numapartition<value_t, index_t>(
+                           csrmatrix<value_t, index_t>(dataset).view());
+    cout << "Split the rows across " << partition.nodes.size()
+         << " NUMA node(s):\n";
+    for (size_t node = 0; node < partition.nodes.size(); node++)
+      cout << "  - node " << node << ": " << partition.parts[node].nrows
+           << " rows, " << partition.nodes[node].size() << " CPUs\n";
   }
-  algorithm::proxgradient<value_t, index_t, boosting::momentum, step::constant,
-                          smoothing::rmsprop, prox::l1norm,
-                          execution::consistent>
-      alg;
-  alg.step_parameters(1. / B);
-  alg.boosting_parameters(0.9, 0.1);
-  alg.smoothing_parameters(0.999, 1E-8);
-  alg.execution_parameters(W);
-  string suffix =
-      "consistent-mb-adam-block-" + to_string(Md) + "-" + to_string(W);
-#elif defined INCONSISTENT_MB_ADAM_BLOCK
-#define BLOCK
-  if (!vm.count("nworkers")) {
-    cerr << "Number of workers is not set.\n";
-    cout << options << '\n';
-    return 5;
+  const string statsfile = datasets->path(id, fid, ".stats");
+  value_t L = 0.25 * M;
+  try {
+    dsstats<value_t, index_t> stats;
+    stats.load(statsfile);
+    L = stats.batchlipschitz(M);
+    cout << "Using L = " << L << " from " << statsfile << ".\n";
+  } catch (const exception &ex) {
+    cout << "Using L = " << L << " for unit-norm samples (" << ex.what()
+         << ").\n";
   }
-  algorithm::proxgradient<value_t, index_t, boosting::momentum, step::constant,
-                          smoothing::rmsprop, prox::l1norm,
-                          execution::inconsistent>
-      alg;
-  alg.step_parameters(1. / B);
-  alg.boosting_parameters(0.9, 0.1);
-  alg.smoothing_parameters(0.999, 1E-8);
-  alg.execution_parameters(W);
-  string suffix =
-      "inconsistent-mb-adam-block-" + to_string(Md) + "-" + to_string(W);
-#endif
-
-  alg.prox_parameters(lambda1);
-
+  const counterrng gen(seed, 0);
   vector<value_t> x0(d);
-  mt19937 generator(random_device{}());
-  normal_distribution<value_t> dist(5, 3);
-  transform(begin(x0), end(x0), begin(x0),
-            [&](const value_t v) -> value_t { return dist(generator); });
-  alg.initialize(x0);
-
-  customlogger<value_t, index_t> logger;
-  utility::sampler::uniform<index_t> sampler;
-  sampler.parameters(0, N - 1);
+  for (index_t idx = 0; idx < d; idx++)
+    x0[idx] = value_t(5 + 3 * gen.normal(idx));
 
-  cout << "Experiment will run with:\n";
+  cout << "Experiments will run with:\n";
   cout << "  - dsfile : " << dsfile << '\n';
-  cout << "  - suffix : " << suffix << '\n';
   cout << "  - M      : " << M << '\n';
-#ifdef BLOCK
   cout << "  - B      : " << Md << '\n';
-#endif
   cout << "  - lambda1: " << lambda1 << '\n';
   cout << "  - K      : " << K << '\n';
   auto tstart = chrono::high_resolution_clock::now();
 
-#ifdef BLOCK
-  utility::sampler::uniform<index_t> blocksampler;
-  blocksampler.parameters(0, d - 1);
-  alg.solve(logloss, utility::sampler::component, sampler, M,
-            utility::sampler::coordinate, blocksampler, Md, logger,
-            terminator::iteration<value_t, index_t>(K));
-#else
-  alg.solve(logloss, utility::sampler::component, sampler, M, logger,
-            terminator::iteration<value_t, index_t>(K));
-#endif
-
-  const string logfile = "results/" + datasets[id].first + "-" +
-                         to_string(fid) + "-" + suffix + ".bin";
-  cout << "Writing the logged states to " << logfile << "...\n";
-  ofstream file(logfile, ios_base::binary);
-  const index_t numlogs = distance(begin(logger), end(logger));
-  file.write(reinterpret_cast<const char *>(&lambda1), sizeof(value_t));
-  file.write(reinterpret_cast<const char *>(&numlogs), sizeof(index_t));
-  file.write(reinterpret_cast<const char *>(&d), sizeof(index_t));
-  for (const auto log : logger) {
-    const auto k = log.getk();
-    const auto t = log.gett();
-    const auto &x = log.getx();
-    file.write(reinterpret_cast<const char *>(&k), sizeof(index_t));
-    file.write(reinterpret_cast<const char *>(&t), sizeof(value_t));
-    file.write(reinterpret_cast<const char *>(&x[0]), d * sizeof(value_t));
+  const string prefix =
+      "results/" + (*datasets)[id].name + "-" + to_string(fid) + "-";
+  vector<string> suffixes;
+  for (const auto &variant : variants) {
+    vector<scalingrun<value_t, index_t>> runs;
+    for (const auto nworkers : isthreaded(variant) ? Ws : vector<index_t>{1}) {
+      const mbsettings<value_t, index_t> settings{
+          N, d, M, Md, K, nworkers, L, lambda1, seed};
+      const string suffix = mbsuffix(variant, settings);
+      const string logfile = prefix + suffix + ".bin";
+      suffixes.push_back(suffix);
+
+      unique_ptr<streamlogger<value_t, index_t>> logger;
+      try {
+        logger.reset(
+            new streamlogger<value_t, index_t>(logfile, lambda1, d, delta));
+      } catch (const exception &ex) {
+        cerr << "Error occurred: " << ex.what() << '\n';
+        return 6;
+      }
+
+      const anyloss<value_t, index_t> runloss =
+          numa ? anyloss<value_t, index_t>(
+                     numalogistic<value_t, index_t>(partition))
+               : logloss;
+      auto loss = instrument(runloss, prof["oracle"]);
+      cout << "Running " << suffix << "...\n";
+      auto rstart = chrono::high_resolution_clock::now();
+      auto log = instrument(*logger, prof["logger"]);
+      {
+        const scope s(prof["solve-" + suffix]);
+        const affinityguard affinity;
+        solvemb(variant, loss, view, log, settings, x0);
+      }
+      auto rend = chrono::high_resolution_clock::now();
+      const double rseconds = chrono::duration<double>(rend - rstart).count();
+      cout << "Finished " << suffix << " in " << rseconds << "s.\n";
+
+      cout << "Flushing the logged states to " << logfile << "...\n";
+      try {
+        const scope s(prof["close"]);
+        logger->close();
+        cout << "Wrote " << logger->size() << " states in "
+             << logger->bytes() / 1024 << "KBs with " << logger->nstalls()
+             << " stalls.\n";
+      } catch (const exception &ex) {
+        cerr << "Error occurred: " << ex.what() << '\n';
+        return 6;
+      }
+
+      if (scaling) {
+        cout << "Evaluating the logged states of " << suffix << "...\n";
+        runs.push_back(
+            scalingrun<value_t, index_t>{nworkers, K, rseconds, {}, {}});
+        try {
+          const scope s(prof["evaluate"]);
+          evaluatelog(logfile, logloss, runs.back());
+        } catch (const exception &ex) {
+          cerr << "Error occurred: " << ex.what() << '\n';
+          return 6;
+        }
+      }
+    }
+
+    if (scaling) {
+      const string scalingfile = prefix + variant + "-scaling.csv";
+      try {
+        savescaling(scalingfile, runs,
+                    vm.count("target")
+                        ? target
+                        : numeric_limits<value_t>::quiet_NaN());
+        cout << "Saved the scaling report to " << scalingfile << ".\n";
+      } catch (const exception &ex) {
+        cerr << "Error occurred: " << ex.what() << '\n';
+        return 6;
+      }
+    }
   }
 
   auto tend = chrono::high_resolution_clock::now();
@@ -229,5 +292,19 @@ int main(int argc, char *argv[]) {
   cout << "Experiment took " << hours << ':' << minutes << ':' << seconds
        << ".\n";
 
+  if (profile) {
+    const string profilefile =
+        prefix + (suffixes.size() == 1 ? suffixes[0] : "shared") +
+        "-profile.csv";
+    try {
+      prof.save(profilefile);
+      cout << "Saved the profile" << (prof.hascounters() ? "" : " (no counters)")
+           << " to " << profilefile << ".\n";
+    } catch (const exception &ex) {
+      cerr << "Error occurred: " << ex.what() << '\n';
+      return 7;
+    }
+  }
+
   return 0;
 }
@@ -1,10 +1,13 @@
-#include <cassert>
+#include <algorithm>
 #include <chrono>
 #include <cmath>
+#include <cstdint>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <random>
+#include <string>
+#include <thread>
 using namespace std;
 
 #include "boost/program_options.hpp"
@@ -13,124 +16,9 @@ namespace po = boost::program_options;
 #include "polo/polo.hpp"
 using namespace polo;
 
-template <class value_t, class index_t> struct quadratic {
-  quadratic(const index_t d, const value_t t) : d{d} {
-    vector<value_t> D(size_t(d) * d), Q(size_t(d) * d), tau(d), work(1);
-    q = vector<value_t>(d);
-
-    mt19937 gen(random_device{}());
-    normal_distribution<value_t> standard;
-    uniform_real_distribution<value_t> uniform(-1, 1);
-
-    for (auto &val : Q)
-      val = standard(gen);
-
-    for (auto &val : q)
-      val = standard(gen);
-
-    int info = utility::matrix::lapack<value_t>::geqrfp(d, d, &Q[0], d, &tau[0],
-                                                        &work[0], -1);
-    assert(info == 0);
-
-    int lwork = work[0];
-    work.resize(lwork);
-    info = utility::matrix::lapack<value_t>::geqrfp(d, d, &Q[0], d, &tau[0],
-                                                    &work[0], lwork);
-    assert(info == 0);
-
-    D[0] = 1 / t;
-    for (index_t i = 1; i < d - 1; i++)
-      D[size_t(i) * d + i] = pow(t, uniform(gen));
-    D[size_t(d) * d - 1] = t;
-
-    info = utility::matrix::lapack<value_t>::ormqr(
-        'L', 'T', d, d, d, &Q[0], d, &tau[0], &D[0], d, &work[0], -1);
-    assert(info == 0);
-
-    lwork = work[0];
-    work.resize(lwork);
-    info = utility::matrix::lapack<value_t>::ormqr(
-        'L', 'T', d, d, d, &Q[0], d, &tau[0], &D[0], d, &work[0], lwork);
-    assert(info == 0);
-
-    info = utility::matrix::lapack<value_t>::ormqr(
-        'R', 'N', d, d, d, &Q[0], d, &tau[0], &D[0], d, &work[0], -1);
-    assert(info == 0);
-
-    lwork = work[0];
-    work.resize(lwork);
-    info = utility::matrix::lapack<value_t>::ormqr(
-        'R', 'N', d, d, d, &Q[0], d, &tau[0], &D[0], d, &work[0], lwork);
-    assert(info == 0);
-
-    this->Q = vector<value_t>((size_t(d) + 1) * d / 2);
-    size_t idx{0};
-    for (index_t col = 0; col < d; col++)
-      for (index_t row = col; row < d; row++)
-        this->Q[idx++] = D[size_t(col) * d + row];
-
-    xopt_ = q;
-    for (auto &val : xopt_)
-      val *= -1;
-
-    factor = this->Q;
-    info = utility::matrix::lapack<value_t>::pptrf('L', d, &factor[0]);
-    assert(info == 0);
-
-    info = utility::matrix::lapack<value_t>::pptrs('L', d, 1, &factor[0],
-                                                   &xopt_[0], d);
-    assert(info == 0);
-  }
-
-  value_t operator()(const value_t *x, value_t *g) {
-    vector<value_t> Qx(d);
-    utility::matrix::blas<value_t>::spmv('L', d, 1, &Q[0], x, 1, 0, &Qx[0], 1);
-
-    value_t fval{0};
-    for (index_t idx = 0; idx < d; idx++) {
-      fval += 0.5 * x[idx] * Qx[idx] + q[idx] * x[idx];
-      g[idx] = Qx[idx] + q[idx];
-    }
-    return fval;
-  }
-
-  vector<value_t> eigenvalues() const {
-    vector<value_t> D(d), e(d - 1), tau(d - 1), work(4 * size_t(d)), Q(this->Q);
-    int info = utility::matrix::lapack<value_t>::sptrd('L', d, &Q[0], &D[0],
-                                                       &e[0], &tau[0]);
-    assert(info == 0);
-
-    info = utility::matrix::lapack<value_t>::pteqr('N', d, &D[0], &e[0],
-                                                   nullptr, 1, &work[0]);
-    assert(info == 0);
-
-    return D;
-  }
-
-  vector<value_t> xopt() const noexcept { return xopt_; }
-
-  template <class T1, class T2>
-  friend ostream &operator<<(ostream &, const quadratic<T1, T2> &);
-
-private:
-  index_t d;
-  vector<value_t> Q, factor, q, xopt_;
-};
-
-template <class value_t, class index_t>
-ostream &operator<<(ostream &os, const quadratic<value_t, index_t> &qp) {
-  const size_t d = qp.d;
-  size_t idx{0};
-  for (size_t row = 0; row < d; row++) {
-    for (size_t col = 0; col < d; col++)
-      if (col > row)
-        os << setw(10) << setprecision(6) << '.' << '\t';
-      else
-        os << setw(10) << setprecision(6) << qp.Q[idx++] << '\t';
-    os << "\t\t" << setw(10) << setprecision(6) << qp.q[row] << '\n';
-  }
-  return os;
-}
+#include "instrument.hpp"
+#include "lockstep.hpp"
+#include "quadratic.hpp"
 
 template <class T> ostream &operator<<(ostream &os, const vector<T> &vec) {
   const size_t d = vec.size();
@@ -154,6 +42,10 @@ using value_t = float;
 int main(int argc, char *argv[]) {
   index_t d, K;
   value_t L;
+  uint64_t seed;
+  unsigned int nthreads;
+  string cache;
+  bool inlockstep, profile;
 
   po::options_description options("Options");
   options.add_options()("help,h", "prints the help screen")(
@@ -162,7 +54,19 @@ int main(int argc, char *argv[]) {
       "dimension,d", po::value<index_t>(&d),
       "sets the dimension of the decision vector (>=1)")(
       "max-iter,K", po::value<index_t>(&K)->default_value(1000),
-      "sets the maximum number of iterations");
+      "sets the maximum number of iterations")(
+      "seed,s", po::value<uint64_t>(&seed)->default_value(0),
+      "sets the seed of the generated problem")(
+      "nthreads,j",
+      po::value<unsigned int>(&nthreads)->default_value(
+          max(thread::hardware_concurrency(), 1u)),
+      "sets the number of threads generating the problem")(
+      "cache,c", po::value<string>(&cache)->default_value("data"),
+      "sets the directory of cached problems (empty to disable caching)")(
+      "lockstep,l", po::bool_switch(&inlockstep),
+      "runs the three solvers concurrently, sharing each pass over Q")(
+      "profile,P", po::bool_switch(&profile),
+      "records per-phase timings and hardware counters");
 
   po::variables_map vm;
   po::store(po::parse_command_line(argc, argv, options), vm);
@@ -183,11 +87,49 @@ int main(int argc, char *argv[]) {
     cerr << "K must be set to be at least 0.\n";
     cout << options << '\n';
     return 3;
+  } else if (nthreads < 1) {
+    cerr << "Number of threads must be at least 1.\n";
+    cout << options << '\n';
+    return 4;
   }
 
-  cout << "Generating the QP problem...\n";
-  quadratic<value_t, index_t> qp(d, L);
-  cout << "QP problem has been generated.\n";
+  const string mode = inlockstep ? "lockstep" : "serial";
+  profiler prof(profile);
+  quadratic<value_t, index_t> qp;
+  const string cachefile =
+      cache.empty() ? "" : quadratic<value_t, index_t>::cachefile(cache, d, L,
+                                                                  seed);
+  bool cached{false};
+  if (!cachefile.empty() && ifstream(cachefile)) {
+    try {
+      const scope s(prof["cache-load"]);
+      qp.load(cachefile, d, L, seed);
+      cached = true;
+      cout << "QP problem has been loaded from " << cachefile << ".\n";
+    } catch (const exception &ex) {
+      cerr << "Ignoring the cached problem: " << ex.what() << '\n';
+    }
+  }
+  if (!cached) {
+    cout << "Generating the QP problem...\n";
+    auto gstart = chrono::high_resolution_clock::now();
+    {
+      const scope s(prof["generate"]);
+      qp = quadratic<value_t, index_t>(d, L, seed, nthreads);
+    }
+    auto gend = chrono::high_resolution_clock::now();
+    cout << "QP problem has been generated in "
+         << chrono::duration_cast<chrono::milliseconds>(gend - gstart).count()
+         << "ms.\n";
+    if (!cachefile.empty()) {
+      try {
+        const scope s(prof["cache-save"]);
+        qp.save(cachefile);
+      } catch (const exception &ex) {
+        cerr << "QP problem could not be cached: " << ex.what() << '\n';
+      }
+    }
+  }
   if (d <= 10)
     cout << qp << '\n';
 
@@ -229,34 +171,83 @@ int main(int argc, char *argv[]) {
 
   auto tstart = chrono::high_resolution_clock::now();
 
-  cout << "Starting Gradient Descent iterations...\n";
-  gd.solve(qp, logger, terminator, enc);
-  ofstream file("results/qp-serial-gd.csv");
-  file << "k,t,fval,|xk-xopt|,f-fopt\n";
-  for (const auto &log : logger)
-    file << log.getk() << ',' << log.gett() << ',' << log.getf() << ','
-         << dist(log.getx(), xopt) << ',' << log.getf() - fopt << '\n';
-  cout << "Gradient Descent iterations have finished.\n";
-
-  cout << "Starting Nesterov iterations...\n";
-  logger = customlogger<value_t, index_t>();
-  nesterov.solve(qp, logger, terminator, enc);
-  file = ofstream("results/qp-serial-nesterov.csv");
-  file << "k,t,fval,|xk-xopt|,f-fopt\n";
-  for (const auto &log : logger)
-    file << log.getk() << ',' << log.gett() << ',' << log.getf() << ','
-         << dist(log.getx(), xopt) << ',' << log.getf() - fopt << '\n';
-  cout << "Nesterov iterations have finished.\n";
-
-  cout << "Starting Adam iterations...\n";
-  logger = customlogger<value_t, index_t>();
-  adam.solve(qp, logger, terminator, enc);
-  file = ofstream("results/qp-serial-adam.csv");
-  file << "k,t,fval,|xk-xopt|,f-fopt\n";
-  for (const auto &log : logger)
-    file << log.getk() << ',' << log.gett() << ',' << log.getf() << ','
-         << dist(log.getx(), xopt) << ',' << log.getf() - fopt << '\n';
-  cout << "Adam iterations have finished.\n";
+  auto save = [&](const string &name,
+                  const customlogger<value_t, index_t> &logger) {
+    const scope s(prof["write"]);
+    ofstream file("results/qp-" + mode + "-" + name + ".csv");
+    file << "k,t,fval,|xk-xopt|,f-fopt\n";
+    for (const auto &log : logger)
+      file << log.getk() << ',' << log.gett() << ',' << log.getf() << ','
+           << dist(log.getx(), xopt) << ',' << log.getf() - fopt << '\n';
+  };
+
+  if (inlockstep) {
+    cout << "Starting Gradient Descent, Nesterov and Adam iterations in "
+            "lockstep...\n";
+    lockstep<value_t, index_t> oracle(qp, 3, prof["oracle-batch"],
+                                      prof["oracle-wait"]);
+    vector<lockstep<value_t, index_t>::participant> participants{
+        oracle[0], oracle[1], oracle[2]};
+    vector<customlogger<value_t, index_t>> loggers(3);
+    vector<thread> solvers;
+    solvers.emplace_back([&, terminator, enc]() mutable {
+      const scope s(prof["solve-gd"]);
+      auto loss = participants[0];
+      auto log = instrument(loggers[0], prof["logger"]);
+      gd.solve(loss, log, terminator, enc);
+      oracle.leave();
+    });
+    solvers.emplace_back([&, terminator, enc]() mutable {
+      const scope s(prof["solve-nesterov"]);
+      auto loss = participants[1];
+      auto log = instrument(loggers[1], prof["logger"]);
+      nesterov.solve(loss, log, terminator, enc);
+      oracle.leave();
+    });
+    solvers.emplace_back([&, terminator, enc]() mutable {
+      const scope s(prof["solve-adam"]);
+      auto loss = participants[2];
+      auto log = instrument(loggers[2], prof["logger"]);
+      adam.solve(loss, log, terminator, enc);
+      oracle.leave();
+    });
+    for (auto &solver : solvers)
+      solver.join();
+    save("gd", loggers[0]);
+    save("nesterov", loggers[1]);
+    save("adam", loggers[2]);
+    cout << "Lockstep iterations have finished after " << oracle.nbatches()
+         << " passes over Q.\n";
+  } else {
+    const auto oracle = instrument(qp, prof["oracle"]);
+    auto log = instrument(logger, prof["logger"]);
+
+    cout << "Starting Gradient Descent iterations...\n";
+    {
+      const scope s(prof["solve-gd"]);
+      gd.solve(oracle, log, terminator, enc);
+    }
+    save("gd", logger);
+    cout << "Gradient Descent iterations have finished.\n";
+
+    cout << "Starting Nesterov iterations...\n";
+    logger = customlogger<value_t, index_t>();
+    {
+      const scope s(prof["solve-nesterov"]);
+      nesterov.solve(oracle, log, terminator, enc);
+    }
+    save("nesterov", logger);
+    cout << "Nesterov iterations have finished.\n";
+
+    cout << "Starting Adam iterations...\n";
+    logger = customlogger<value_t, index_t>();
+    {
+      const scope s(prof["solve-adam"]);
+      adam.solve(oracle, log, terminator, enc);
+    }
+    save("adam", logger);
+    cout << "Adam iterations have finished.\n";
+  }
 
   auto tend = chrono::high_resolution_clock::now();
   auto telapsed = chrono::duration_cast<chrono::seconds>(tend - tstart).count();
@@ -266,5 +257,17 @@ int main(int argc, char *argv[]) {
   cout << "Experiments took " << hours << ':' << minutes << ':' << seconds
        << ".\n";
 
+  if (profile) {
+    const string profilefile = "results/qp-" + mode + "-profile.csv";
+    try {
+      prof.save(profilefile);
+      cout << "Saved the profile" << (prof.hascounters() ? "" : " (no counters)")
+           << " to " << profilefile << ".\n";
+    } catch (const exception &ex) {
+      cerr << "Error occurred: " << ex.what() << '\n';
+      return 5;
+    }
+  }
+
   return 0;
 }
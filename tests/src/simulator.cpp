@@ -1,11 +1,13 @@
+#include <algorithm>
 #include <chrono>
 #include <cmath>
 #include <cstdlib>
+#include <cstring>
 #include <exception>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <mutex>
-#include <sstream>
 #include <string>
 #include <thread>
 #include <tuple>
@@ -19,14 +21,23 @@ namespace po = boost::program_options;
 #include "polo/polo.hpp"
 using namespace polo;
 
+#include "csrfile.hpp"
+#include "evaluator.hpp"
+#include "instrument.hpp"
+#include "iterlog.hpp"
+#include "mappedfile.hpp"
+#include "registry.hpp"
+
 using index_t = int32_t;
 using value_t = float;
 
 int main(int argc, char *argv[]) {
   size_t id;
   string suffix;
-  value_t threshold;
+  value_t threshold, target;
   unsigned int W;
+  index_t batch;
+  bool mapped, profile;
 
   po::options_description options("Options");
   options.add_options()("help,h", "prints the help message")(
@@ -36,10 +47,18 @@ int main(int argc, char *argv[]) {
                                             "suffix added to the dataset name")(
       "threshold,t", po::value<value_t>(&threshold)->default_value(1e-2),
       "sets the threshold in reporting nnz")(
+      "target,T", po::value<value_t>(&target),
+      "reports the first iterate whose objective reaches the target")(
       "nworkers,W",
       po::value<unsigned int>(&W)->default_value(
           thread::hardware_concurrency()),
-      "sets the number of worker processes");
+      "sets the number of worker processes")(
+      "batch-size,k", po::value<index_t>(&batch)->default_value(16),
+      "sets the number of iterates evaluated in one pass over the data")(
+      "mmap,m", po::bool_switch(&mapped),
+      "replays the iterates in place from a memory-mapped log file")(
+      "profile,P", po::bool_switch(&profile),
+      "records per-phase timings and hardware counters");
 
   po::variables_map vm;
   po::store(po::parse_command_line(argc, argv, options), vm);
@@ -50,31 +69,21 @@ int main(int argc, char *argv[]) {
     return 0;
   }
 
-  ifstream dslist("data/datasets.lst");
-  if (!dslist) {
-    cerr << "Error occured: data/datasets.lst could not be opened.\n";
+  unique_ptr<const registry<value_t, index_t>> datasets;
+  try {
+    datasets.reset(new registry<value_t, index_t>("data/datasets.lst"));
+  } catch (const exception &ex) {
+    cerr << "Error occurred: " << ex.what() << '\n';
     return 1;
   }
 
-  vector<pair<string, bool>> datasets;
-  string line;
-  while (getline(dslist, line)) {
-    istringstream ss(line);
-    string dsname;
-    bool dense;
-    ss >> dsname >> boolalpha >> dense;
-    datasets.emplace_back(dsname, dense);
-  }
-
   if (!vm.count("dataset-id")) {
     cerr << "Dataset ID is not set.\n";
     cout << options << '\n';
     return 2;
-  } else if (id >= datasets.size()) {
+  } else if (id >= datasets->size()) {
     cerr << "Dataset ID is set to " << id << ". Supported ID's are:\n";
-    for (size_t idx = 0; idx < datasets.size(); idx++)
-      cerr << "  - " << idx << ") " << datasets[idx].first << "("
-           << (datasets[idx].second ? "dense" : "sparse") << ")\n";
+    datasets->print(cerr);
     return 2;
   }
 
@@ -82,93 +91,218 @@ int main(int argc, char *argv[]) {
     cerr << "Suffix is not set.\n";
     cout << options << '\n';
     return 3;
+  } else if (batch < 1) {
+    cerr << "Batch size must be at least 1.\n";
+    cout << options << '\n';
+    return 3;
   }
 
-  const string dsfile = "data/" + datasets[id].first + "-0.bin";
-  loss::data<value_t, index_t> dataset;
+  profiler prof(profile);
+  csrmatrix<value_t, index_t> A;
+  mappedcsr<value_t, index_t> mappedA;
+  csrview<value_t, index_t> view;
   try {
-    dataset.load(dsfile, datasets[id].second);
+    const scope s(prof["load"]);
+    if (datasets->find(id, 0, "csr") ||
+        ifstream(datasets->path(id, 0, ".csr"))) {
+      mappedA = datasets->map(id, 0);
+      view = mappedA.view();
+    } else {
+      A = csrmatrix<value_t, index_t>(datasets->load(id, 0));
+      view = A.view();
+    }
   } catch (const exception &ex) {
     cerr << "Error occurred: " << ex.what() << '\n';
     return 4;
   }
-  loss::logistic<value_t, index_t> logloss(dataset);
 
-  const string logfile("results/" + datasets[id].first + "-" + suffix);
-  ifstream infile(logfile + ".bin", ios_base::binary);
-  if (!infile) {
-    cerr << "Error occured: " << logfile << ".bin could not be opened.\n";
+  const string logfile("results/" + (*datasets)[id].name + "-" + suffix);
+  ifstream infile;
+  mappedfile inmap;
+  unique_ptr<logreader<value_t, index_t>> reader;
+  const char *logdata{nullptr};
+  try {
+    if (iterlog::islog(logfile + ".bin"))
+      reader.reset(new logreader<value_t, index_t>(logfile + ".bin"));
+    else if (mapped) {
+      inmap = mappedfile(logfile + ".bin", MADV_SEQUENTIAL);
+      logdata = inmap.data();
+    } else {
+      infile.open(logfile + ".bin", ios_base::binary);
+      if (!infile)
+        throw runtime_error(logfile + ".bin could not be opened.");
+    }
+  } catch (const exception &ex) {
+    cerr << "Error occurred: " << ex.what() << '\n';
     return 5;
   }
 
-  value_t lambda1, t;
+  value_t lambda1;
   index_t n{0}, N, d;
+  const size_t header = sizeof(value_t) + 2 * sizeof(index_t);
 
-  infile.read(reinterpret_cast<char *>(&lambda1), sizeof(value_t));
-  infile.read(reinterpret_cast<char *>(&N), sizeof(index_t));
-  infile.read(reinterpret_cast<char *>(&d), sizeof(index_t));
+  if (reader) {
+    lambda1 = reader->lambda1();
+    N = reader->size();
+    d = reader->dimension();
+  } else if (mapped) {
+    if (inmap.size() < header) {
+      cerr << "Error occurred: " << logfile << ".bin is truncated.\n";
+      return 5;
+    }
+    memcpy(&lambda1, logdata, sizeof(value_t));
+    memcpy(&N, logdata + sizeof(value_t), sizeof(index_t));
+    memcpy(&d, logdata + sizeof(value_t) + sizeof(index_t), sizeof(index_t));
+  } else {
+    infile.read(reinterpret_cast<char *>(&lambda1), sizeof(value_t));
+    infile.read(reinterpret_cast<char *>(&N), sizeof(index_t));
+    infile.read(reinterpret_cast<char *>(&d), sizeof(index_t));
+  }
+
+  const size_t stride = sizeof(index_t) + sizeof(value_t) + d * sizeof(value_t);
+  if (!reader && mapped && inmap.size() < header + N * stride) {
+    cerr << "Error occurred: " << logfile << ".bin is truncated.\n";
+    return 5;
+  }
 
   cout << "Simulating from " << logfile << ".bin with\n";
   cout << "  - lambda1  : " << lambda1 << '\n';
   cout << "  - threshold: " << threshold << '\n';
   cout << "  - numlogs  : " << N << '\n';
   cout << "  - W        : " << W << '\n';
+  cout << "  - k        : " << batch << '\n';
+  cout << "  - format   : " << (reader ? "indexed" : "raw") << '\n';
+  if (!reader)
+    cout << "  - mmap     : " << boolalpha << mapped << '\n';
   auto tstart = chrono::high_resolution_clock::now();
 
-  mutex input;
+  mutex input, output;
   vector<tuple<index_t, value_t, value_t, index_t>> traces(N);
 
+  auto evaluate = [&, lambda1](blockevaluator<value_t, index_t> &evaluator,
+                              const index_t nbegin, const index_t ncols,
+                              const index_t *ks, const value_t *ts) {
+    {
+      const scope s(prof["evaluate"]);
+      evaluator.evaluate(ncols, lambda1, threshold);
+    }
+
+    lock_guard<mutex> lock(output);
+    for (index_t col = 0; col < ncols; col++) {
+      const value_t fval = evaluator.getf(col);
+      const index_t nnz = evaluator.getnnz(col);
+      cout << "k = " << ks[col] << ", t = " << ts[col] << ", fval = " << fval
+           << ", nnz = " << nnz << '\n';
+      traces[nbegin + col] =
+          tuple<index_t, value_t, value_t, index_t>(ks[col], ts[col], fval, nnz);
+    }
+  };
+
   vector<thread> workers(W);
   cout << "Spawning " << W
        << " workers to simulate the experiment in parallel...\n";
-  for (auto &worker : workers)
-    worker = thread([&, d, lambda1]() {
-      index_t nlocal, k;
-      value_t t, fval;
-      vector<value_t> x(d), g(d);
-      while (true) {
-        {
-          lock_guard<mutex> lock(input);
-          nlocal = n++;
-          if (nlocal >= N)
-            break;
-          infile.read(reinterpret_cast<char *>(&k), sizeof(index_t));
-          infile.read(reinterpret_cast<char *>(&t), sizeof(value_t));
-          infile.read(reinterpret_cast<char *>(&x[0]), d * sizeof(value_t));
+  if (reader) {
+    for (unsigned int w = 0; w < W; w++)
+      workers[w] = thread([&, w, d]() {
+        const index_t nbegin = index_t(int64_t(N) * w / W);
+        const index_t nend = index_t(int64_t(N) * (w + 1) / W);
+        blockevaluator<value_t, index_t> evaluator(view, batch);
+        vector<index_t> ks(batch);
+        vector<value_t> ts(batch), x(d);
+        index_t previous{-1};
+        for (index_t nlocal = nbegin; nlocal < nend; nlocal += batch) {
+          const index_t ncols = min(batch, nend - nlocal);
+          for (index_t col = 0; col < ncols; col++) {
+            reader->read(nlocal + col, &x[0], previous);
+            previous = nlocal + col;
+            ks[col] = reader->getk(previous);
+            ts[col] = reader->gett(previous);
+            evaluator.set(col, &x[0]);
+          }
+          evaluate(evaluator, nlocal, ncols, &ks[0], &ts[0]);
         }
-        fval = logloss(&x[0], &g[0]);
-
-        value_t absval, maxabsval{0};
-        for (const value_t val : x) {
-          absval = abs(val);
-          if (absval > maxabsval)
-            maxabsval = absval;
-          fval += lambda1 * absval;
+      });
+  } else if (mapped) {
+    const char *entries = logdata + header;
+    for (unsigned int w = 0; w < W; w++)
+      workers[w] = thread([&, w]() {
+        const index_t nbegin = index_t(int64_t(N) * w / W);
+        const index_t nend = index_t(int64_t(N) * (w + 1) / W);
+        blockevaluator<value_t, index_t> evaluator(view, batch);
+        vector<index_t> ks(batch);
+        vector<value_t> ts(batch);
+        for (index_t nlocal = nbegin; nlocal < nend; nlocal += batch) {
+          const index_t ncols = min(batch, nend - nlocal);
+          for (index_t col = 0; col < ncols; col++) {
+            const char *entry = entries + (nlocal + col) * stride;
+            memcpy(&ks[col], entry, sizeof(index_t));
+            memcpy(&ts[col], entry + sizeof(index_t), sizeof(value_t));
+            evaluator.set(col, reinterpret_cast<const value_t *>(
+                                   entry + sizeof(index_t) + sizeof(value_t)));
+          }
+          evaluate(evaluator, nlocal, ncols, &ks[0], &ts[0]);
         }
-
-        index_t nnz{0};
-        for (const value_t val : x)
-          if (abs(val) >= threshold * maxabsval)
-            nnz++;
-
-        cout << "k = " << k << ", t = " << t << ", fval = " << fval
-             << ", nnz = " << nnz << '\n';
-
-        traces[nlocal] =
-            tuple<index_t, value_t, value_t, index_t>(k, t, fval, nnz);
-      }
-    });
+      });
+  } else {
+    for (auto &worker : workers)
+      worker = thread([&, d]() {
+        index_t nlocal, ncols;
+        blockevaluator<value_t, index_t> evaluator(view, batch);
+        vector<index_t> ks(batch);
+        vector<value_t> ts(batch), xs(size_t(batch) * d);
+        while (true) {
+          {
+            lock_guard<mutex> lock(input);
+            const scope s(prof["read"]);
+            nlocal = n;
+            ncols = min(batch, N - nlocal);
+            if (ncols <= 0)
+              break;
+            n += ncols;
+            for (index_t col = 0; col < ncols; col++) {
+              infile.read(reinterpret_cast<char *>(&ks[col]), sizeof(index_t));
+              infile.read(reinterpret_cast<char *>(&ts[col]), sizeof(value_t));
+              infile.read(reinterpret_cast<char *>(&xs[size_t(col) * d]),
+                          d * sizeof(value_t));
+            }
+          }
+          for (index_t col = 0; col < ncols; col++)
+            evaluator.set(col, &xs[size_t(col) * d]);
+          evaluate(evaluator, nlocal, ncols, &ks[0], &ts[0]);
+        }
+      });
+  }
 
   for (auto &worker : workers)
     worker.join();
 
-  ofstream outfile(logfile + ".csv");
-
   cout << "Saving the traces to " << logfile << ".csv...\n";
-  outfile << "k,t,fval,nnz\n";
-  for (const auto &trace : traces)
-    outfile << get<0>(trace) << ',' << get<1>(trace) << ',' << get<2>(trace)
-            << ',' << get<3>(trace) << '\n';
+  {
+    const scope s(prof["write"]);
+    ofstream outfile(logfile + ".csv");
+    outfile << "k,t,fval,nnz\n";
+    for (const auto &trace : traces)
+      outfile << get<0>(trace) << ',' << get<1>(trace) << ',' << get<2>(trace)
+              << ',' << get<3>(trace) << '\n';
+  }
+
+  if (vm.count("target")) {
+    const auto reached =
+        find_if(begin(traces), end(traces),
+                [=](const tuple<index_t, value_t, value_t, index_t> &trace) {
+                  return get<2>(trace) <= target;
+                });
+    ofstream outfile(logfile + "-target.csv");
+    outfile << "target,k,t\n" << target << ',';
+    if (reached == end(traces)) {
+      cout << "The target " << target << " was not reached.\n";
+      outfile << ",\n";
+    } else {
+      cout << "Reached the target " << target << " at k = " << get<0>(*reached)
+           << ", t = " << get<1>(*reached) << ".\n";
+      outfile << get<0>(*reached) << ',' << get<1>(*reached) << '\n';
+    }
+  }
 
   auto tend = chrono::high_resolution_clock::now();
   auto telapsed = chrono::duration_cast<chrono::seconds>(tend - tstart).count();
@@ -178,5 +312,16 @@ int main(int argc, char *argv[]) {
   cout << "Simulation took " << hours << ':' << minutes << ':' << seconds
        << ".\n";
 
+  if (profile) {
+    try {
+      prof.save(logfile + "-profile.csv");
+      cout << "Saved the profile" << (prof.hascounters() ? "" : " (no counters)")
+           << " to " << logfile << "-profile.csv.\n";
+    } catch (const exception &ex) {
+      cerr << "Error occurred: " << ex.what() << '\n';
+      return 6;
+    }
+  }
+
   return 0;
 }
@@ -0,0 +1,272 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+using namespace std;
+
+#include "boost/program_options.hpp"
+namespace po = boost::program_options;
+
+#include "polo/polo.hpp"
+using namespace polo;
+
+#include "csrfile.hpp"
+#include "csrlogistic.hpp"
+#include "dsstats.hpp"
+#include "parallel.hpp"
+#include "registry.hpp"
+#include "rng.hpp"
+#include "streamlogger.hpp"
+#include "variants.hpp"
+
+using index_t = int32_t;
+using value_t = float;
+
+struct run {
+  string variant, suffix;
+  mbsettings<value_t, index_t> settings;
+  int cpu{-1};
+  double seconds{0};
+  size_t states{0};
+};
+
+int main(int argc, char *argv[]) {
+  size_t id;
+  index_t fid;
+  vector<string> variants;
+  vector<index_t> Ms, Ks;
+  vector<value_t> lambdas;
+  unsigned int jobs;
+  uint64_t seed;
+  bool delta, mmap, pinned;
+
+  po::options_description options("Options");
+  options.add_options()("help,h", "prints the help message")(
+      "dataset-id,d", po::value<size_t>(&id),
+      "sets the id of the dataset to load")(
+      "file-id,f", po::value<index_t>(&fid), "sets the file id to load")(
+      "algorithm,a",
+      po::value<vector<string>>(&variants)
+          ->multitoken()
+          ->default_value(vector<string>{"serial-mb-amsgrad"},
+                          "serial-mb-amsgrad"),
+      "sets the algorithms (serial-mb, serial-mb-adam, serial-mb-amsgrad, "
+      "serial-mb-amsgrad-lazy)")(
+      "batch-size,M",
+      po::value<vector<index_t>>(&Ms)->multitoken()->default_value(
+          vector<index_t>{1000}, "1000"),
+      "sets the sizes of the mini-batches")(
+      "lambda1,l",
+      po::value<vector<value_t>>(&lambdas)->multitoken()->default_value(
+          vector<value_t>{1e-6}, "1e-6"),
+      "sets the l1 penalties")(
+      "max-iter,K",
+      po::value<vector<index_t>>(&Ks)->multitoken()->default_value(
+          vector<index_t>{100000}, "100000"),
+      "sets the maximum numbers of iterations")(
+      "jobs,j",
+      po::value<unsigned int>(&jobs)->default_value(allowedcpus().size()),
+      "sets the number of concurrent runs")(
+      "seed,s", po::value<uint64_t>(&seed)->default_value(0),
+      "sets the seed of the initial point and the samplers of all runs")(
+      "pin,p", po::bool_switch(&pinned),
+      "pins each concurrent run to a CPU and the loggers' writers to the rest")(
+      "delta-log,D", po::bool_switch(&delta),
+      "delta-encodes the logged states against the previous ones")(
+      "mmap", po::bool_switch(&mmap),
+      "maps the dataset in CSR format instead of loading it");
+
+  po::variables_map vm;
+  po::store(po::parse_command_line(argc, argv, options), vm);
+  po::notify(vm);
+
+  if (vm.count("help")) {
+    cout << options << '\n';
+    return 0;
+  }
+
+  unique_ptr<const registry<value_t, index_t>> datasets;
+  try {
+    datasets.reset(new registry<value_t, index_t>("data/datasets.lst"));
+  } catch (const exception &ex) {
+    cerr << "Error occurred: " << ex.what() << '\n';
+    return 1;
+  }
+
+  if (!vm.count("dataset-id")) {
+    cerr << "Dataset ID is not set.\n";
+    cout << options << '\n';
+    return 2;
+  } else if (id >= datasets->size()) {
+    cerr << "Dataset ID is set to " << id << ". Supported ID's are:\n";
+    datasets->print(cerr);
+    return 2;
+  }
+
+  if (!vm.count("file-id")) {
+    cerr << "File ID is not set.\n";
+    cout << options << '\n';
+    return 3;
+  }
+
+  for (const auto &variant : variants)
+    if (!ismbvariant(variant) || isblock(variant)) {
+      cerr << "Algorithm " << variant << " is not supported.\n";
+      cout << options << '\n';
+      return 4;
+    }
+  if (any_of(begin(Ms), end(Ms), [](const index_t M) { return M < 1; }) ||
+      any_of(begin(Ks), end(Ks), [](const index_t K) { return K < 0; })) {
+    cerr << "Batch sizes must be at least 1 and K at least 0.\n";
+    cout << options << '\n';
+    return 4;
+  } else if (jobs < 1) {
+    cerr << "Number of jobs must be at least 1.\n";
+    cout << options << '\n';
+    return 4;
+  }
+
+  const string dsfile = datasets->path(id, fid, mmap ? ".csr" : ".bin");
+  loss::data<value_t, index_t> dataset;
+  mappedcsr<value_t, index_t> mapped;
+  try {
+    if (mmap) {
+      cout << "Mapping dataset from " << dsfile << "...\n";
+      mapped = datasets->map(id, fid);
+    } else {
+      cout << "Loading dataset from " << dsfile << "...\n";
+      dataset = datasets->load(id, fid);
+    }
+  } catch (const exception &ex) {
+    cerr << "Error occurred: " << ex.what() << '\n';
+    return 5;
+  }
+  const anyloss<value_t, index_t> logloss =
+      mmap ? anyloss<value_t, index_t>(
+                 csrlogistic<value_t, index_t>(mapped.view()))
+           : anyloss<value_t, index_t>(
+                 loss::logistic<value_t, index_t>(dataset));
+
+  const index_t N = mmap ? mapped.view().nrows : dataset.nsamples();
+  const index_t d = mmap ? mapped.view().ncols : dataset.nfeatures();
+  csrmatrix<value_t, index_t> rows;
+  if (!mmap && find(begin(variants), end(variants),
+                    "serial-mb-amsgrad-lazy") != end(variants))
+    rows = csrmatrix<value_t, index_t>(dataset);
+  const csrview<value_t, index_t> view = mmap ? mapped.view() : rows.view();
+  const string statsfile = datasets->path(id, fid, ".stats");
+  dsstats<value_t, index_t> stats;
+  bool hasstats{true};
+  try {
+    stats.load(statsfile);
+  } catch (const exception &ex) {
+    hasstats = false;
+    cout << "Using L = M / 4 for unit-norm samples (" << ex.what() << ").\n";
+  }
+
+  /* the names match logloss-shared's unless lambda1 or K are swept, too */
+  const string prefix =
+      "results/" + (*datasets)[id].name + "-" + to_string(fid) + "-";
+  vector<run> runs;
+  for (const auto &variant : variants)
+    for (const auto M : Ms)
+      for (const auto lambda1 : lambdas)
+        for (const auto K : Ks) {
+          const value_t L =
+              hasstats ? stats.batchlipschitz(M) : value_t(0.25 * M);
+          const mbsettings<value_t, index_t> settings{
+              N, d, M, 0, K, 1, L, lambda1, seed};
+          ostringstream suffix;
+          suffix << mbsuffix(variant, settings);
+          if (lambdas.size() > 1 || Ks.size() > 1)
+            suffix << '-' << lambda1 << '-' << K;
+          runs.push_back(run{variant, suffix.str(), settings});
+        }
+  /* longest runs first, so that the last ones to finish are the short ones */
+  stable_sort(begin(runs), end(runs), [](const run &lhs, const run &rhs) {
+    return int64_t(lhs.settings.M) * lhs.settings.K >
+           int64_t(rhs.settings.M) * rhs.settings.K;
+  });
+
+  const counterrng gen(seed, 0);
+  vector<value_t> x0(d);
+  for (index_t idx = 0; idx < d; idx++)
+    x0[idx] = value_t(5 + 3 * gen.normal(idx));
+
+  const vector<unsigned int> allowed = allowedcpus();
+  vector<unsigned int> cpus = allowed, writercpus;
+  if (pinned) {
+    /* the loggers' writers run on the CPUs left over, or on all of them */
+    cpus.resize(min<size_t>(jobs, cpus.size()));
+    writercpus.assign(begin(allowed) + cpus.size(), end(allowed));
+    if (writercpus.empty())
+      writercpus = allowed;
+  }
+
+  cout << "Sweep will run with:\n";
+  cout << "  - dsfile : " << dsfile << '\n';
+  cout << "  - runs   : " << runs.size() << '\n';
+  cout << "  - jobs   : " << (pinned ? cpus.size() : jobs) << '\n';
+  cout << "  - pinned : " << boolalpha << pinned << '\n';
+  auto tstart = chrono::high_resolution_clock::now();
+
+  mutex output;
+  bool failed{false};
+  auto execute = [&](const size_t idx) {
+    run &r = runs[idx];
+    r.cpu = sched_getcpu();
+    {
+      lock_guard<mutex> lock(output);
+      cout << "Starting " << r.suffix << " on CPU " << r.cpu << "...\n";
+    }
+    auto rstart = chrono::high_resolution_clock::now();
+    try {
+      streamlogger<value_t, index_t> logger(prefix + r.suffix + ".bin",
+                                            r.settings.lambda1, d, delta, 16,
+                                            writercpus);
+      solvemb(r.variant, logloss, view, logger, r.settings, x0);
+      logger.close();
+      r.states = logger.size();
+    } catch (const exception &ex) {
+      lock_guard<mutex> lock(output);
+      cerr << "Error occurred in " << r.suffix << ": " << ex.what() << '\n';
+      failed = true;
+      return;
+    }
+    auto rend = chrono::high_resolution_clock::now();
+    r.seconds = chrono::duration<double>(rend - rstart).count();
+    lock_guard<mutex> lock(output);
+    cout << "Finished " << r.suffix << " in " << r.seconds << "s.\n";
+  };
+  if (pinned)
+    parallel_for(runs.size(), cpus, execute);
+  else
+    parallel_for(runs.size(), jobs, execute);
+
+  const string sweepfile = prefix + "sweep.csv";
+  ofstream file(sweepfile);
+  file << "algorithm,M,lambda1,K,cpu,seconds,states\n";
+  for (const auto &r : runs)
+    file << r.variant << ',' << r.settings.M << ',' << r.settings.lambda1
+         << ',' << r.settings.K << ',' << r.cpu << ',' << r.seconds << ','
+         << r.states << '\n';
+  if (!file) {
+    cerr << "Error occurred: " << sweepfile << " could not be written.\n";
+    return 6;
+  }
+
+  auto tend = chrono::high_resolution_clock::now();
+  auto telapsed = chrono::duration_cast<chrono::seconds>(tend - tstart).count();
+  auto hours = telapsed / 3600;
+  auto minutes = (telapsed % 3600) / 60;
+  auto seconds = (telapsed % 3600) % 60;
+  cout << "Sweep took " << hours << ':' << minutes << ':' << seconds << ".\n";
+
+  return failed ? 6 : 0;
+}